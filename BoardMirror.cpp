@@ -0,0 +1,156 @@
+#include "BoardMirror.hpp"
+
+#include "Game.hpp" //BOARD_WIDTH, BOARD_HEIGHT
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+static constexpr char Magic[8] = {'b','m','i','r','r','0','0','1'};
+
+BoardMirror::BoardMirror(std::string const &path_, uint32_t max_players) : path(path_) {
+	file_size = file_bytes(BOARD_WIDTH, BOARD_HEIGHT, max_players);
+
+	#ifdef _WIN32
+	throw std::runtime_error("Board mirrors are not supported on this platform.");
+	#else
+	int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		throw std::system_error(errno, std::system_category(), "failed to open board mirror '" + path + "'");
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t(st.st_size) != file_size && ftruncate(fd, file_size) != 0)) {
+		int err = errno;
+		::close(fd);
+		throw std::system_error(err, std::system_category(), "failed to size board mirror '" + path + "'");
+	}
+	void *mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd); //(the mapping keeps the file open)
+	if (mapping == MAP_FAILED) {
+		throw std::system_error(errno, std::system_category(), "failed to map board mirror '" + path + "'");
+	}
+	base = reinterpret_cast< uint8_t * >(mapping);
+
+	//start over unless this is a mirror with the same layout (in which case the sequence carries on,
+	//so readers that mapped the file under a previous server don't mistake old frames for new ones):
+	Header *h = header();
+	if (std::memcmp(h->magic, Magic, sizeof(Magic)) != 0 || h->width != BOARD_WIDTH || h->height != BOARD_HEIGHT || h->max_players != max_players) {
+		std::memset(base, 0, file_size);
+		h->width = BOARD_WIDTH;
+		h->height = BOARD_HEIGHT;
+		h->max_players = max_players;
+		h->sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(h->magic, Magic, sizeof(Magic));
+	}
+	#endif
+}
+
+BoardMirror::~BoardMirror() {
+	#ifndef _WIN32
+	if (base) munmap(base, file_size);
+	#endif
+}
+
+void BoardMirror::publish(uint32_t tick, std::string const &board, std::vector< Player > const &players) {
+	Header *h = header();
+	Frame *frame = reinterpret_cast< Frame * >(h + 1);
+	uint8_t *tiles = reinterpret_cast< uint8_t * >(frame + 1);
+	Player *slots = reinterpret_cast< Player * >(tiles + board_bytes(h->width, h->height));
+
+	//(a writer that died mid-frame left the sequence odd; round it up)
+	uint64_t sequence = (h->sequence.load(std::memory_order_relaxed) + 1) & ~uint64_t(1);
+	h->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	frame->tick = tick;
+	frame->player_count = uint32_t(std::min< size_t >(players.size(), h->max_players));
+	size_t tile_count = size_t(h->width) * h->height;
+	size_t copied = std::min(board.size(), tile_count);
+	std::memcpy(tiles, board.data(), copied);
+	std::memset(tiles + copied, 0, tile_count - copied);
+	if (frame->player_count) std::memcpy(slots, players.data(), frame->player_count * sizeof(Player));
+
+	h->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+BoardMirrorReader::BoardMirrorReader(std::string const &path_) : path(path_) {
+	#ifdef _WIN32
+	throw std::runtime_error("Board mirrors are not supported on this platform.");
+	#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::system_error(errno, std::system_category(), "failed to open board mirror '" + path + "'");
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int err = errno;
+		::close(fd);
+		throw std::system_error(err, std::system_category(), "failed to stat board mirror '" + path + "'");
+	}
+	file_size = size_t(st.st_size);
+	if (file_size < sizeof(BoardMirror::Header)) {
+		::close(fd);
+		throw std::runtime_error("'" + path + "' is too small to be a board mirror.");
+	}
+	void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED) {
+		throw std::system_error(errno, std::system_category(), "failed to map board mirror '" + path + "'");
+	}
+	base = reinterpret_cast< uint8_t const * >(mapping);
+
+	BoardMirror::Header const *h = header();
+	if (std::memcmp(h->magic, Magic, sizeof(Magic)) != 0 || BoardMirror::file_bytes(h->width, h->height, h->max_players) > file_size) {
+		munmap(const_cast< uint8_t * >(base), file_size);
+		throw std::runtime_error("'" + path + "' is not a board mirror.");
+	}
+	#endif
+}
+
+BoardMirrorReader::~BoardMirrorReader() {
+	#ifndef _WIN32
+	if (base) munmap(const_cast< uint8_t * >(base), file_size);
+	#endif
+}
+
+bool BoardMirrorReader::read(BoardMirror::Snapshot *snapshot, uint32_t max_attempts) const {
+	assert(snapshot);
+	BoardMirror::Header const *h = header();
+	BoardMirror::Frame const *frame = reinterpret_cast< BoardMirror::Frame const * >(h + 1);
+	uint8_t const *tiles = reinterpret_cast< uint8_t const * >(frame + 1);
+	BoardMirror::Player const *slots = reinterpret_cast< BoardMirror::Player const * >(tiles + BoardMirror::board_bytes(h->width, h->height));
+
+	for (uint32_t attempt = 0; attempt < max_attempts; ++attempt) {
+		uint64_t before = h->sequence.load(std::memory_order_acquire);
+		if (before == 0) return false; //nothing published yet
+		if (before & 1) {
+			//writer is mid-frame; it only takes a moment:
+			std::this_thread::yield();
+			continue;
+		}
+
+		//copy everything out first, and only trust it if the sequence didn't move meanwhile:
+		snapshot->tick = frame->tick;
+		snapshot->width = h->width;
+		snapshot->height = h->height;
+		snapshot->board.assign(reinterpret_cast< char const * >(tiles), size_t(h->width) * h->height);
+		uint32_t count = std::min(frame->player_count, h->max_players);
+		snapshot->players.assign(slots, slots + count);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (h->sequence.load(std::memory_order_relaxed) == before) return true;
+	}
+	return false;
+}
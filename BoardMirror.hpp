@@ -0,0 +1,107 @@
+#pragma once
+
+/*
+ * BoardMirror publishes the server's board and player table into a memory-mapped file,
+ * so local tools can watch the game without connecting as clients:
+ *  - the server calls publish() once per tick; it never waits on readers
+ *  - any number of BoardMirrorReaders map the same file and copy out consistent snapshots
+ *
+ * Consistency comes from a seqlock: the writer makes the sequence number odd while it
+ * copies a frame in and even again when it is done; a reader retries if the number was
+ * odd or changed while it was copying. Put the file on a memory-backed filesystem
+ * (e.g., /dev/shm/treasure.mirror) and it never touches the disk.
+ * For example:
+
+//server:
+BoardMirror mirror("/dev/shm/treasure.mirror");
+while (true) {
+	//...tick...
+	mirror.publish(tick, board, players);
+}
+
+//tool:
+BoardMirrorReader reader("/dev/shm/treasure.mirror");
+BoardMirror::Snapshot snapshot;
+if (reader.read(&snapshot)) {
+	//...look at snapshot.board, snapshot.players...
+}
+
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BoardMirror {
+	//create (or take over) the mirror file at 'path', with room for up to 'max_players' players:
+	// (throws std::system_error if the file can't be mapped, std::runtime_error on platforms without mmap)
+	BoardMirror(std::string const &path, uint32_t max_players = 256);
+	~BoardMirror();
+
+	BoardMirror(BoardMirror const &) = delete;
+	BoardMirror &operator=(BoardMirror const &) = delete;
+
+	struct Player {
+		uint32_t id = 0;
+		uint8_t pos_x = 0xff; //(0xff = not on the board yet)
+		uint8_t pos_y = 0xff;
+		uint16_t rtt_ms = 0xffff; //round-trip time to the player (0xffff = not measured yet)
+		int32_t total = 0;
+		char name[20] = { 0 }; //(nul-terminated; longer names are cut off)
+	};
+	static_assert(sizeof(Player) == 32, "Player is part of the file format.");
+
+	struct Snapshot {
+		uint32_t tick = 0;
+		uint32_t width = 0, height = 0;
+		std::string board; //width * height tiles, encoded as in the board message
+		std::vector< Player > players;
+	};
+
+	//replace the published frame (players beyond max_players are left out):
+	void publish(uint32_t tick, std::string const &board, std::vector< Player > const &players);
+
+	//-- file layout --
+	struct Header {
+		char magic[8];
+		uint32_t width, height; //board size
+		uint32_t max_players;
+		uint32_t padding;
+		std::atomic< uint64_t > sequence; //odd while the writer is in the middle of a frame
+	};
+	struct Frame {
+		uint32_t tick;
+		uint32_t player_count;
+		//followed by the board (width * height bytes, padded to a multiple of 8), then max_players Players
+	};
+	static size_t board_bytes(uint32_t width, uint32_t height) { return (size_t(width) * height + 7) & ~size_t(7); }
+	static size_t file_bytes(uint32_t width, uint32_t height, uint32_t max_players) {
+		return sizeof(Header) + sizeof(Frame) + board_bytes(width, height) + max_players * sizeof(Player);
+	}
+
+	//-- internals --
+	std::string path;
+	size_t file_size = 0;
+	uint8_t *base = nullptr;
+	Header *header() const { return reinterpret_cast< Header * >(base); }
+};
+
+struct BoardMirrorReader {
+	//map an existing mirror file (throws std::system_error if it can't, std::runtime_error if it isn't a mirror):
+	BoardMirrorReader(std::string const &path);
+	~BoardMirrorReader();
+
+	BoardMirrorReader(BoardMirrorReader const &) = delete;
+	BoardMirrorReader &operator=(BoardMirrorReader const &) = delete;
+
+	//copy out the current frame; returns false if nothing has been published yet or if
+	//the writer kept changing it for 'max_attempts' tries in a row:
+	bool read(BoardMirror::Snapshot *snapshot, uint32_t max_attempts = 1000) const;
+
+	//-- internals --
+	std::string path;
+	size_t file_size = 0;
+	uint8_t const *base = nullptr;
+	BoardMirror::Header const *header() const { return reinterpret_cast< BoardMirror::Header const * >(base); }
+};
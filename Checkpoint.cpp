@@ -0,0 +1,136 @@
+#include "Checkpoint.hpp"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+static constexpr char Magic[8] = {'c','h','k','p','t','0','0','1'};
+
+//FNV-1a, seeded with the slot's generation and size so a torn header doesn't validate either:
+static uint64_t checksum(uint64_t generation, uint64_t size, uint8_t const *data) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	auto mix = [&hash](uint8_t b) {
+		hash ^= b;
+		hash *= 0x100000001b3ull;
+	};
+	for (uint32_t i = 0; i < 8; ++i) mix(uint8_t(generation >> (8 * i)));
+	for (uint32_t i = 0; i < 8; ++i) mix(uint8_t(size >> (8 * i)));
+	for (uint64_t i = 0; i < size; ++i) mix(data[i]);
+	return hash;
+}
+
+Checkpoint::Checkpoint(std::string const &path_, size_t capacity_) : path(path_), capacity((capacity_ + 7) & ~size_t(7)) {
+	//(capacity is rounded up to keep both slots' headers aligned)
+	file_size = sizeof(Header) + 2 * (sizeof(Slot) + capacity);
+
+	#ifdef _WIN32
+	base = new uint8_t[file_size]();
+	{ //read the existing file, if any:
+		std::ifstream in(path, std::ios::binary);
+		if (in) in.read(reinterpret_cast< char * >(base), file_size);
+	}
+	#else
+	int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		throw std::system_error(errno, std::system_category(), "failed to open checkpoint '" + path + "'");
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t(st.st_size) != file_size && ftruncate(fd, file_size) != 0)) {
+		int err = errno;
+		::close(fd);
+		throw std::system_error(err, std::system_category(), "failed to size checkpoint '" + path + "'");
+	}
+	void *mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd); //(the mapping keeps the file open)
+	if (mapping == MAP_FAILED) {
+		throw std::system_error(errno, std::system_category(), "failed to map checkpoint '" + path + "'");
+	}
+	base = reinterpret_cast< uint8_t * >(mapping);
+	#endif
+
+	//start over if this isn't a checkpoint file with matching layout:
+	Header *header = reinterpret_cast< Header * >(base);
+	if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->capacity != capacity) {
+		std::memset(base, 0, file_size);
+		std::memcpy(header->magic, Magic, sizeof(Magic));
+		header->capacity = capacity;
+	}
+}
+
+Checkpoint::~Checkpoint() {
+	#ifdef _WIN32
+	delete[] base;
+	#else
+	msync(base, file_size, MS_ASYNC);
+	munmap(base, file_size);
+	#endif
+}
+
+Checkpoint::Slot *Checkpoint::slot(uint32_t index) const {
+	assert(index < 2);
+	return reinterpret_cast< Slot * >(base + sizeof(Header) + index * (sizeof(Slot) + capacity));
+}
+
+uint8_t *Checkpoint::slot_data(uint32_t index) const {
+	return reinterpret_cast< uint8_t * >(slot(index) + 1);
+}
+
+bool Checkpoint::slot_valid(uint32_t index) const {
+	Slot const &s = *slot(index);
+	return s.generation != 0 && s.size <= capacity && s.checksum == checksum(s.generation, s.size, slot_data(index));
+}
+
+bool Checkpoint::load(std::vector< uint8_t > *data) const {
+	assert(data);
+	int32_t newest = -1;
+	for (uint32_t i = 0; i < 2; ++i) {
+		if (!slot_valid(i)) continue;
+		if (newest < 0 || slot(i)->generation > slot(newest)->generation) newest = int32_t(i);
+	}
+	if (newest < 0) return false;
+	uint8_t const *at = slot_data(uint32_t(newest));
+	data->assign(at, at + slot(uint32_t(newest))->size);
+	return true;
+}
+
+void Checkpoint::save(std::vector< uint8_t > const &data) {
+	if (data.size() > capacity) {
+		throw std::runtime_error("Checkpoint of " + std::to_string(data.size()) + " bytes doesn't fit in '" + path + "' (capacity " + std::to_string(capacity) + ").");
+	}
+
+	//overwrite the older (or broken) slot, so the newer one survives a crash part way through:
+	bool valid[2] = { slot_valid(0), slot_valid(1) };
+	uint64_t generation[2] = { valid[0] ? slot(0)->generation : 0, valid[1] ? slot(1)->generation : 0 };
+	uint32_t target = (generation[0] <= generation[1] ? 0 : 1);
+	uint64_t next_generation = std::max(generation[0], generation[1]) + 1;
+
+	Slot &s = *slot(target);
+	s.generation = 0; //(mark the slot as being written)
+	std::atomic_thread_fence(std::memory_order_release);
+	if (!data.empty()) std::memcpy(slot_data(target), data.data(), data.size());
+	s.size = data.size();
+	s.checksum = checksum(next_generation, data.size(), slot_data(target));
+	std::atomic_thread_fence(std::memory_order_release);
+	s.generation = next_generation;
+
+	#ifdef _WIN32
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast< char const * >(base), file_size);
+	#else
+	//ask for the write-back now rather than whenever the kernel gets to it (doesn't wait):
+	msync(base, file_size, MS_ASYNC);
+	#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+ * Checkpoint keeps a small blob of state in a memory-mapped file, so it survives the process crashing:
+ *  - save() copies the blob into the mapping; the kernel writes it back to the file on its own schedule
+ *  - load() returns the most recently saved blob (e.g., when the process is started again)
+ *
+ * The file holds two slots, and save() always overwrites the older one, so a crash in the middle
+ * of save() leaves the previous checkpoint intact. Each slot carries a checksum to tell them apart.
+ * For example:
+
+Checkpoint checkpoint("server.checkpoint");
+std::vector< uint8_t > state;
+if (checkpoint.load(&state)) {
+	//...restore from state...
+}
+while (true) {
+	//...run...
+	checkpoint.save(state);
+}
+
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Checkpoint {
+	//open (or create) the checkpoint file at 'path', with room for blobs of up to 'capacity' bytes:
+	// (an existing file made with a different capacity is started over)
+	Checkpoint(std::string const &path, size_t capacity = 64 * 1024);
+	~Checkpoint();
+
+	Checkpoint(Checkpoint const &) = delete;
+	Checkpoint &operator=(Checkpoint const &) = delete;
+
+	//get the newest valid blob; returns false if nothing has been saved yet:
+	bool load(std::vector< uint8_t > *data) const;
+
+	//replace the checkpoint with 'data'; throws std::runtime_error if it is bigger than capacity:
+	void save(std::vector< uint8_t > const &data);
+
+	//-- internals --
+	struct Header {
+		char magic[8];
+		uint64_t capacity;
+	};
+	struct Slot {
+		uint64_t generation; //zero = never written; the valid slot with the larger generation is newest
+		uint64_t size;
+		uint64_t checksum; //of generation, size, and data
+	};
+
+	std::string path;
+	size_t capacity;
+	size_t file_size;
+	uint8_t *base = nullptr; //whole file (mapped on posix; a copy that save() writes out on windows)
+
+	Slot *slot(uint32_t index) const;
+	uint8_t *slot_data(uint32_t index) const;
+	bool slot_valid(uint32_t index) const;
+};
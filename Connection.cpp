@@ -24,6 +24,10 @@ typedef int ssize_t;
 #include <netinet/ip.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <poll.h>
+#include <sys/un.h> //for the shared-memory transport's unix-domain sockets
+#include <sys/mman.h>
+#include <fcntl.h>
 
 #define closesocket close
 
@@ -36,8 +40,10 @@ typedef int ssize_t;
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
+#include <new>
 
 //NOTE: much of the sockets code herein is based on http-tweak's single-header http server
 // see: https://github.com/ixchow/http-tweak
@@ -45,11 +51,209 @@ typedef int ssize_t;
 //Also, some help and examples for getaddrinfo from: https://beej.us/guide/bgnet/html/multi/syscalls.html
 
 
+//---------------------------------
+//Shared-memory transport:
+// Connections between processes on the same host can move their data through a pair of
+// single-producer/single-consumer byte rings in a shared mapping instead of through the kernel.
+// The server creates the mapping when a client connects to its unix-domain socket (Server::listen_local)
+// and passes it over with SCM_RIGHTS. The socket stays open afterward: one byte sent over it is a
+// "doorbell" telling the other side to look at the rings, and its closing means the peer is gone.
+
+struct ShmRing {
+	enum : uint64_t { Capacity = 1 << 20 };
+	alignas(64) std::atomic< uint64_t > head; //bytes ever written; advanced by the producer
+	alignas(64) std::atomic< uint64_t > tail; //bytes ever read; advanced by the consumer
+	alignas(64) uint8_t data[Capacity];
+
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+	}
+
+	//copy as much of 'src' as fits; returns bytes written:
+	size_t write(uint8_t const *src, size_t size) {
+		uint64_t h = head.load(std::memory_order_relaxed);
+		uint64_t t = tail.load(std::memory_order_acquire);
+		size_t count = std::min< size_t >(size, size_t(Capacity - (h - t)));
+		size_t at = size_t(h % Capacity);
+		size_t first = std::min< size_t >(count, size_t(Capacity) - at);
+		std::memcpy(data + at, src, first);
+		std::memcpy(data, src + first, count - first);
+		head.store(h + count, std::memory_order_release);
+		return count;
+	}
+
+	//append up to 'limit' bytes to 'dst'; returns bytes read. sets 'was_full' if the ring was at least half full
+	// (the producer may be waiting for room, so it should get a doorbell):
+	size_t read(std::vector< uint8_t > &dst, size_t limit, bool *was_full) {
+		uint64_t t = tail.load(std::memory_order_relaxed);
+		uint64_t h = head.load(std::memory_order_acquire);
+		*was_full = (h - t >= Capacity / 2);
+		size_t count = std::min< size_t >(limit, size_t(h - t));
+		size_t at = size_t(t % Capacity);
+		size_t first = std::min< size_t >(count, size_t(Capacity) - at);
+		dst.insert(dst.end(), data + at, data + at + first);
+		dst.insert(dst.end(), data, data + (count - first));
+		tail.store(t + count, std::memory_order_release);
+		return count;
+	}
+};
+static_assert(std::atomic< uint64_t >::is_always_lock_free, "shared-memory rings need lock-free 64-bit atomics");
+
+struct ShmChannel {
+	void *mapping = nullptr;
+	ShmRing *tx = nullptr; //ring this side writes
+	ShmRing *rx = nullptr; //ring this side reads
+
+	ShmChannel(void *mapping_, bool is_server) : mapping(mapping_) {
+		ShmRing *rings = reinterpret_cast< ShmRing * >(mapping);
+		//ring 0 carries server-to-client data, ring 1 client-to-server:
+		tx = &rings[is_server ? 0 : 1];
+		rx = &rings[is_server ? 1 : 0];
+	}
+	~ShmChannel() {
+		#ifndef _WIN32
+		munmap(mapping, 2 * sizeof(ShmRing));
+		#endif
+	}
+};
+
+#ifndef _WIN32
+//pass descriptor 'fd' to the process at the other end of unix-domain 'socket', along with 'size' bytes of data:
+// (blocks until sent; returns false on error)
+static bool send_fd(Socket socket, int fd, void const *data, size_t size) {
+	struct iovec iov;
+	iov.iov_base = const_cast< void * >(data);
+	iov.iov_len = size;
+	union {
+		struct cmsghdr header;
+		char space[CMSG_SPACE(sizeof(int))];
+	} control;
+	memset(&control, 0, sizeof(control));
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.space;
+	msg.msg_controllen = sizeof(control.space);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	ssize_t ret = sendmsg(socket, &msg, 0);
+	return ret == ssize_t(size);
+}
+
+//receive a descriptor sent with send_fd, along with exactly 'size' bytes of data:
+// (blocks until received; returns the descriptor, or -1 on error)
+static int recv_fd(Socket socket, void *data, size_t size) {
+	struct iovec iov;
+	iov.iov_base = data;
+	iov.iov_len = size;
+	union {
+		struct cmsghdr header;
+		char space[CMSG_SPACE(sizeof(int))];
+	} control;
+	memset(&control, 0, sizeof(control));
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.space;
+	msg.msg_controllen = sizeof(control.space);
+
+	ssize_t ret = recvmsg(socket, &msg, MSG_WAITALL);
+	struct cmsghdr *cmsg = (ret == ssize_t(size) ? CMSG_FIRSTHDR(&msg) : nullptr);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+		return -1;
+	}
+	int fd;
+	memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	return fd;
+}
+
+//tell the peer to look at the rings:
+// (if the socket buffer is full of doorbells already, the peer is sure to look anyway)
+static void ring_doorbell(Connection &c) {
+	uint8_t bell = 0;
+	#ifdef MSG_NOSIGNAL
+	send(c.socket, &bell, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+	#else
+	send(c.socket, &bell, 1, MSG_DONTWAIT);
+	#endif
+}
+
+//move as much of send_buffer into the ring as fits:
+static void flush_shm(Connection &c) {
+	if (c.socket == InvalidSocket || c.send_buffer.empty()) return;
+	size_t wrote = c.shm->tx->write(c.send_buffer.data(), c.send_buffer.size());
+	if (wrote) {
+		c.send_buffer.erase(c.send_buffer.begin(), c.send_buffer.begin() + wrote);
+		ring_doorbell(c);
+	}
+}
+
+//server side of the handshake: create the rings and pass them over 'socket':
+static ShmChannel *offer_shm_channel(Socket socket) {
+	static uint32_t serial = 0;
+	std::string name = "/nest-shm-" + std::to_string(getpid()) + "-" + std::to_string(serial++);
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		std::cerr << "[Server::poll] shm_open() failed: " << strerror(errno) << std::endl;
+		return nullptr;
+	}
+	shm_unlink(name.c_str()); //only reachable through the descriptor from here on
+
+	void *mapping = MAP_FAILED;
+	if (ftruncate(fd, 2 * sizeof(ShmRing)) == 0) {
+		mapping = mmap(nullptr, 2 * sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	if (mapping == MAP_FAILED) {
+		std::cerr << "[Server::poll] couldn't map shared memory: " << strerror(errno) << std::endl;
+		::close(fd);
+		return nullptr;
+	}
+	//(one at a time: array placement-new may put a cookie in front of the elements)
+	ShmRing *rings = static_cast< ShmRing * >(mapping);
+	new (&rings[0]) ShmRing();
+	new (&rings[1]) ShmRing();
+
+	//send the descriptor along with a single byte of ordinary data:
+	uint8_t byte = 's';
+	bool sent = send_fd(socket, fd, &byte, 1);
+	::close(fd);
+	if (!sent) {
+		std::cerr << "[Server::poll] couldn't pass shared memory to client: " << strerror(errno) << std::endl;
+		munmap(mapping, 2 * sizeof(ShmRing));
+		return nullptr;
+	}
+	return new ShmChannel(mapping, true);
+}
+
+//client side of the handshake: receive and map the rings sent over 'socket':
+static ShmChannel *accept_shm_channel(Socket socket) {
+	uint8_t byte = 0;
+	int fd = recv_fd(socket, &byte, 1);
+	if (fd < 0) return nullptr;
+	void *mapping = mmap(nullptr, 2 * sizeof(ShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED) return nullptr;
+	return new ShmChannel(mapping, false);
+}
+#endif
+
+//---------------------------------
+
 void Connection::close() {
 	if (socket != InvalidSocket) {
 		::closesocket(socket);
 		socket = InvalidSocket;
 	}
+	if (shm) {
+		delete shm;
+		shm = nullptr;
+	}
 }
 
 //---------------------------------
@@ -59,48 +263,90 @@ void poll_connections(
 	std::list< Connection > &connections,
 	std::function< void(Connection *, Connection::Event event) > const &on_event,
 	double timeout,
-	Socket listen_socket = InvalidSocket) {
+	Socket listen_socket = InvalidSocket,
+	Socket local_listen_socket = InvalidSocket,
+	size_t read_budget = 0,
+	size_t recv_buffer_limit = 0) {
 
-	fd_set read_fds, write_fds;
-	FD_ZERO(&read_fds);
-	FD_ZERO(&write_fds);
+	//poll set: the listen sockets, then an entry for each connection that is waiting on something:
+	// (poll() rather than select(), so the number of connections isn't capped at FD_SETSIZE)
+	static thread_local std::vector< struct pollfd > fds;
+	static thread_local std::vector< int32_t > fd_of; //per connection, in list order: its entry in fds (or -1)
+	fds.clear();
+	fd_of.clear();
+	auto add_fd = [](Socket s, short events) -> int32_t {
+		struct pollfd fd;
+		fd.fd = s;
+		fd.events = events;
+		fd.revents = 0;
+		fds.emplace_back(fd);
+		return int32_t(fds.size() - 1);
+	};
+	//did poll() report any of 'mask' for the index'th connection? (connections added since never did)
+	auto ready = [](size_t index, short mask) {
+		if (index >= fd_of.size() || fd_of[index] < 0) return false;
+		return (fds[fd_of[index]].revents & mask) != 0;
+	};
+	//(hangups and errors count as readable, so that recv() gets to report them)
+	constexpr short Readable = POLLIN | POLLHUP | POLLERR;
+	constexpr short Writable = POLLOUT | POLLHUP | POLLERR;
 
-	int max = 0;
+	//add listen_socket(s) if needed:
+	int32_t listen_fd = (listen_socket != InvalidSocket ? add_fd(listen_socket, POLLIN) : -1);
+	int32_t local_listen_fd = (local_listen_socket != InvalidSocket ? add_fd(local_listen_socket, POLLIN) : -1);
 
-	//add listen_socket to fd_set if needed:
-	if (listen_socket != InvalidSocket) {
-		max = std::max(max, int(listen_socket));
-		FD_SET(listen_socket, &read_fds);
+	#ifndef _WIN32
+	//shared-memory connections don't need poll to send, so do it now:
+	// (and if one already has data waiting, don't sleep)
+	bool shm_ready = false;
+	for (auto &c : connections) {
+		if (!c.shm || c.socket == InvalidSocket) continue;
+		flush_shm(c);
+		if (!c.shm->rx->empty() && (recv_buffer_limit == 0 || c.recv_buffer.size() < recv_buffer_limit)) shm_ready = true;
 	}
+	if (shm_ready) timeout = 0.0;
+	#else
+	const bool shm_ready = false;
+	#endif
 
-	//add each connection's socket to read (and possibly write) sets:
-	for (auto c : connections) {
-		if (c.socket != InvalidSocket) {
-			max = std::max(max, int(c.socket));
-			FD_SET(c.socket, &read_fds);
-			if (!c.send_buffer.empty()) {
-				FD_SET(c.socket, &write_fds);
-			}
+	//add each connection's socket for reading (and possibly writing):
+	for (auto const &c : connections) {
+		short events = 0;
+		if (c.socket != InvalidSocket && c.connecting) {
+			events = POLLOUT; //(writable once the connection goes through)
+		} else if (c.socket != InvalidSocket) {
+			//(connections with a full recv_buffer aren't polled for reading, so they can't keep waking poll)
+			if (recv_buffer_limit == 0 || c.recv_buffer.size() < recv_buffer_limit) events |= POLLIN;
+			if (!c.send_buffer.empty() && !c.shm) events |= POLLOUT; //(shared-memory connections wait on a doorbell for room instead)
 		}
+		fd_of.emplace_back(events ? add_fd(c.socket, events) : -1);
 	}
 
 	{ //wait (until timeout) for sockets' data to become available:
-		struct timeval tv;
-		tv.tv_sec = std::lround(std::floor(timeout));
-		tv.tv_usec = std::lround((timeout - std::floor(timeout)) * 1e6);
-		//NOTE: on windows nfds is ignored -- https://msdn.microsoft.com/en-us/library/windows/desktop/ms740141(v=vs.85).aspx
-		int ret = select(max + 1, &read_fds, &write_fds, NULL, &tv);
+		//(rounded up to whole milliseconds, so a wait for a timer doesn't wake just short of it)
+		int timeout_ms = int(std::ceil(std::max(0.0, timeout) * 1000.0));
+		#ifdef _WIN32
+		int ret;
+		if (fds.empty()) { //(WSAPoll doesn't take an empty set)
+			Sleep(DWORD(timeout_ms));
+			ret = 0;
+		} else {
+			ret = WSAPoll(fds.data(), ULONG(fds.size()), timeout_ms);
+		}
+		#else
+		int ret = ::poll(fds.data(), nfds_t(fds.size()), timeout_ms);
+		#endif
 
 		if (ret < 0) {
-			std::cerr << "[" << where << "] Select returned an error; will attempt to read/write anyway." << std::endl;
-		} else if (ret == 0) {
+			std::cerr << "[" << where << "] Poll returned an error; will attempt to read/write anyway." << std::endl;
+		} else if (ret == 0 && !shm_ready) {
 			//nothing to read or write.
 			return;
 		}
 	}
 
 	//add new connections as needed:
-	if (listen_socket != InvalidSocket && FD_ISSET(listen_socket, &read_fds)) {
+	if (listen_fd >= 0 && (fds[listen_fd].revents & POLLIN)) {
 		Socket got = accept(listen_socket, NULL, NULL);
 		if (got == InvalidSocket) {
 			//oh well.
@@ -119,16 +365,111 @@ void poll_connections(
 		}
 	}
 
+	#ifndef _WIN32
+	//new shared-memory connections:
+	if (local_listen_fd >= 0 && (fds[local_listen_fd].revents & POLLIN)) {
+		Socket got = accept(local_listen_socket, NULL, NULL);
+		if (got != InvalidSocket) {
+			ShmChannel *channel = offer_shm_channel(got);
+			if (!channel) {
+				::closesocket(got);
+			} else {
+				connections.emplace_back();
+				connections.back().socket = got;
+				connections.back().shm = channel;
+				std::cerr << "[" << where << "] local client connected on " << connections.back().socket << " (shared memory)." << std::endl; //INFO
+				if (on_event) on_event(&connections.back(), Connection::OnOpen);
+			}
+		}
+	}
+	#endif
+
+	//finish outgoing connections (see Server::connect_to) that have gone through or failed:
+	{
+		size_t index = 0;
+		for (auto &c : connections) {
+			if (!ready(index++, Writable) || c.socket == InvalidSocket || !c.connecting) continue;
+			int err = 0;
+			#ifdef _WIN32
+			int len = sizeof(err);
+			#else
+			socklen_t len = sizeof(err);
+			#endif
+			if (getsockopt(c.socket, SOL_SOCKET, SO_ERROR, reinterpret_cast< char * >(&err), &len) < 0) err = errno;
+			if (err != 0) {
+				std::cerr << "[" << where << "] connection on " << c.socket << " failed (" << strerror(err) << "), disconnecting." << std::endl;
+				c.close();
+				if (on_event) on_event(&c, Connection::OnClose);
+				continue;
+			}
+			c.connecting = false;
+			std::cerr << "[" << where << "] connected on " << c.socket << "." << std::endl; //INFO
+			if (on_event) on_event(&c, Connection::OnOpen);
+		}
+	}
+
 	const uint32_t BufferSize = 20000;
 	static thread_local char *buffer = new char[BufferSize];
 
+	#ifndef _WIN32
+	//shared-memory connections: check doorbells, then read from the ring:
+	size_t shm_index = 0;
+	for (auto &c : connections) {
+		bool rang = ready(shm_index++, Readable);
+		if (c.socket == InvalidSocket || !c.shm) continue;
+
+		bool hung_up = false;
+		if (rang) {
+			while (true) {
+				ssize_t ret = recv(c.socket, buffer, BufferSize, MSG_DONTWAIT);
+				if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+				if (ret <= 0) {
+					hung_up = true;
+					break;
+				}
+				if (ret < (ssize_t)BufferSize) break;
+			}
+		}
+
+		//(read even if the peer just hung up, so that whatever it left in the ring still arrives)
+		if (recv_buffer_limit && c.recv_buffer.size() >= recv_buffer_limit) {
+			if (!c.shm->rx->empty()) c.throttled_polls += 1;
+		} else {
+			size_t limit = (read_budget ? read_budget : size_t(-1));
+			if (recv_buffer_limit) limit = std::min(limit, recv_buffer_limit - c.recv_buffer.size());
+			bool was_full = false;
+			size_t got = c.shm->rx->read(c.recv_buffer, limit, &was_full);
+			if (was_full) ring_doorbell(c); //let the producer know there's room again
+			if (!c.shm->rx->empty()) c.throttled_polls += 1;
+			if (got) {
+				c.recv_bytes += got;
+				if (on_event) on_event(&c, Connection::OnRecv);
+			}
+		}
+
+		if (hung_up && c.socket != InvalidSocket) {
+			std::cerr << "[" << where << "] local port closed, disconnecting." << std::endl;
+			c.close();
+			if (on_event) on_event(&c, Connection::OnClose);
+		}
+	}
+	#endif
+
 	//process requests:
+	size_t recv_index = 0;
 	for (auto &c : connections) {
 		//only read from valid sockets marked readable:
-		if (c.socket == InvalidSocket || !FD_ISSET(c.socket, &read_fds)) continue;
+		if (!ready(recv_index++, Readable) || c.socket == InvalidSocket || c.shm || c.connecting) continue;
 
+		size_t budget = (read_budget ? read_budget : size_t(-1));
 		while (true) { //read until more data left to read
-			ssize_t ret = recv(c.socket, buffer, BufferSize, MSG_DONTWAIT);
+			if (budget == 0 || (recv_buffer_limit && c.recv_buffer.size() >= recv_buffer_limit)) {
+				//leave the rest for a later poll (only a throttle if there actually is a rest):
+				if (recv(c.socket, buffer, 1, MSG_PEEK | MSG_DONTWAIT) > 0) c.throttled_polls += 1;
+				break;
+			}
+			uint32_t want = uint32_t(std::min< size_t >(BufferSize, budget));
+			ssize_t ret = recv(c.socket, buffer, want, MSG_DONTWAIT);
 			if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
 				//~no problem~ but no data
 				break;
@@ -146,16 +487,27 @@ void poll_connections(
 				break;
 			} else { //ret > 0
 				c.recv_buffer.insert(c.recv_buffer.end(), buffer, buffer + ret);
+				c.recv_bytes += size_t(ret);
+				budget -= size_t(ret);
 				if (on_event) on_event(&c, Connection::OnRecv);
-				if (ret < BufferSize) break; //ran out of data before buffer: no more data left to read
+				if (c.socket == InvalidSocket) break; //handler closed the connection
+				if (ret < want) break; //ran out of data before buffer: no more data left to read
 			}
 		}
 	}
 
 	//process responses:
+	size_t send_index = 0;
 	for (auto &c : connections) {
+		bool writable = ready(send_index++, Writable);
+		#ifndef _WIN32
+		if (c.shm) {
+			flush_shm(c);
+			continue;
+		}
+		#endif
 		//don't bother with connections unless they are valid, have something to send, and are marked writable:
-		if (c.socket == InvalidSocket || c.send_buffer.empty() || !FD_ISSET(c.socket, &write_fds)) continue;
+		if (c.socket == InvalidSocket || c.connecting || c.send_buffer.empty() || !writable) continue;
 		
 		#ifdef _WIN32
 		ssize_t ret = send(c.socket, reinterpret_cast< char const * >(c.send_buffer.data()), int(c.send_buffer.size()), MSG_DONTWAIT);
@@ -184,7 +536,7 @@ void poll_connections(
 //---------------------------------
 
 
-Server::Server(std::string const &port) {
+Server::Server(std::string const &port, std::string const &takeover_path) {
 
 	#ifdef _WIN32
 	{ //init winsock:
@@ -195,6 +547,9 @@ Server::Server(std::string const &port) {
 	}
 	#endif
 
+	//pick up where a previous server left off, if there is one:
+	if (!takeover_path.empty() && take_over(takeover_path)) return;
+
 	{ //use getaddrinfo to look up how to bind to port:
 		struct addrinfo hints;
 		memset(&hints, 0, sizeof(hints));
@@ -274,20 +629,422 @@ Server::Server(std::string const &port) {
 	}
 }
 
+void Server::listen_local(std::string const &path) {
+	#ifdef _WIN32
+	throw std::runtime_error("Shared-memory connections are not supported on this platform.");
+	#else
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() + 1 > sizeof(addr.sun_path)) {
+		throw std::runtime_error("Local socket path '" + path + "' is too long.");
+	}
+	memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+	Socket s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s == InvalidSocket) {
+		throw std::system_error(errno, std::system_category(), "failed to create local socket");
+	}
+	unlink(path.c_str()); //clear out any stale socket left by a previous run
+	if (bind(s, reinterpret_cast< struct sockaddr * >(&addr), sizeof(addr)) < 0 || ::listen(s, 5) < 0) {
+		int err = errno;
+		closesocket(s);
+		throw std::system_error(err, std::system_category(), "failed to listen on local socket '" + path + "'");
+	}
+	std::cout << "[Server::listen_local] listening for local (shared-memory) clients on " << path << std::endl;
+	local_listen_socket = s;
+	#endif
+}
+
+//---------------------------------
+//Handoff:
+// Over the handoff socket, the old server sends a HandoffHeader (carrying the listen socket), then the
+// local listen socket (if any), then for each connection a HandoffConnection (carrying its socket) followed by
+// its recv_buffer, send_buffer, and game state, and finally the game state for the whole server.
+// The new server answers with a single 'k' once it has everything; until then, the old server still owns it all.
+
+#ifndef _WIN32
+struct HandoffHeader {
+	uint32_t magic;
+	uint32_t connections;
+	uint32_t has_local_listen;
+	uint32_t reserved;
+	uint64_t state_size;
+};
+struct HandoffConnection {
+	uint64_t recv_size;
+	uint64_t send_size;
+	uint64_t state_size;
+};
+static constexpr uint32_t HandoffMagic = 0x686e646f; //'hndo'
+static constexpr int HandoffTimeout = 2; //seconds either side waits on the other before giving up
+
+static bool send_all(Socket socket, void const *data, size_t size) {
+	uint8_t const *at = reinterpret_cast< uint8_t const * >(data);
+	while (size > 0) {
+		#ifdef MSG_NOSIGNAL
+		ssize_t ret = send(socket, at, size, MSG_NOSIGNAL);
+		#else
+		ssize_t ret = send(socket, at, size, 0);
+		#endif
+		if (ret <= 0) return false;
+		at += ret;
+		size -= size_t(ret);
+	}
+	return true;
+}
+
+static bool recv_all(Socket socket, void *data, size_t size) {
+	uint8_t *at = reinterpret_cast< uint8_t * >(data);
+	while (size > 0) {
+		ssize_t ret = recv(socket, at, size, MSG_WAITALL);
+		if (ret <= 0) return false;
+		at += ret;
+		size -= size_t(ret);
+	}
+	return true;
+}
+
+static void set_handoff_timeouts(Socket socket) {
+	struct timeval tv;
+	tv.tv_sec = HandoffTimeout;
+	tv.tv_usec = 0;
+	setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+#endif
+
+void Server::listen_handoff(std::string const &path) {
+	#ifdef _WIN32
+	throw std::runtime_error("Handing off connections is not supported on this platform.");
+	#else
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() + 1 > sizeof(addr.sun_path)) {
+		throw std::runtime_error("Handoff socket path '" + path + "' is too long.");
+	}
+	memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+	Socket s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s == InvalidSocket) {
+		throw std::system_error(errno, std::system_category(), "failed to create handoff socket");
+	}
+	unlink(path.c_str()); //(a previous server's socket; it has already handed off or exited)
+	if (bind(s, reinterpret_cast< struct sockaddr * >(&addr), sizeof(addr)) < 0 || ::listen(s, 1) < 0 || fcntl(s, F_SETFL, O_NONBLOCK) < 0) {
+		int err = errno;
+		closesocket(s);
+		throw std::system_error(err, std::system_category(), "failed to listen on handoff socket '" + path + "'");
+	}
+	std::cout << "[Server::listen_handoff] a restarted server can take over through " << path << std::endl;
+	handoff_listen_socket = s;
+	#endif
+}
+
+bool Server::handoff_requested() {
+	#ifndef _WIN32
+	if (handoff_socket == InvalidSocket && handoff_listen_socket != InvalidSocket) {
+		Socket got = accept(handoff_listen_socket, NULL, NULL);
+		if (got != InvalidSocket) {
+			set_handoff_timeouts(got);
+			handoff_socket = got;
+			std::cout << "[Server::handoff_requested] a new server wants to take over." << std::endl;
+		}
+	}
+	#endif
+	return handoff_socket != InvalidSocket;
+}
+
+bool Server::hand_off(std::vector< uint8_t > const &state, std::function< std::vector< uint8_t >(Connection *) > const &connection_state) {
+	#ifdef _WIN32
+	return false;
+	#else
+	if (handoff_socket == InvalidSocket) return false;
+	Socket s = handoff_socket;
+	handoff_socket = InvalidSocket;
+
+	auto fail = [&](char const *what) {
+		std::cerr << "[Server::hand_off] " << what << " (" << strerror(errno) << "); keeping connections." << std::endl;
+		closesocket(s);
+		return false;
+	};
+
+	//only network connections can be passed along:
+	std::vector< Connection * > passing;
+	for (auto &c : connections) {
+		if (c.socket != InvalidSocket && !c.shm) passing.emplace_back(&c);
+	}
+
+	HandoffHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = HandoffMagic;
+	header.connections = uint32_t(passing.size());
+	header.has_local_listen = (local_listen_socket != InvalidSocket ? 1 : 0);
+	header.state_size = state.size();
+	if (!send_fd(s, listen_socket, &header, sizeof(header))) return fail("couldn't pass listen socket");
+	if (header.has_local_listen) {
+		uint8_t byte = 'l';
+		if (!send_fd(s, local_listen_socket, &byte, 1)) return fail("couldn't pass local listen socket");
+	}
+
+	for (Connection *c : passing) {
+		std::vector< uint8_t > extra;
+		if (connection_state) extra = connection_state(c);
+		HandoffConnection info;
+		info.recv_size = c->recv_buffer.size();
+		info.send_size = c->send_buffer.size();
+		info.state_size = extra.size();
+		if (!send_fd(s, c->socket, &info, sizeof(info))
+		 || !send_all(s, c->recv_buffer.data(), c->recv_buffer.size())
+		 || !send_all(s, c->send_buffer.data(), c->send_buffer.size())
+		 || !send_all(s, extra.data(), extra.size())) {
+			return fail("couldn't pass connection");
+		}
+	}
+	if (!send_all(s, state.data(), state.size())) return fail("couldn't pass state");
+
+	uint8_t ack = 0;
+	if (!recv_all(s, &ack, 1) || ack != 'k') return fail("new server didn't confirm");
+	closesocket(s);
+
+	std::cout << "[Server::hand_off] handed off " << passing.size() << " connections." << std::endl;
+	return true;
+	#endif
+}
+
+bool Server::take_over(std::string const &path) {
+	#ifdef _WIN32
+	std::cerr << "[Server::take_over] not supported on this platform; starting fresh." << std::endl;
+	return false;
+	#else
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() + 1 > sizeof(addr.sun_path)) {
+		throw std::runtime_error("Handoff socket path '" + path + "' is too long.");
+	}
+	memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+	Socket s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s == InvalidSocket) {
+		throw std::system_error(errno, std::system_category(), "failed to create handoff socket");
+	}
+	if (connect(s, reinterpret_cast< struct sockaddr * >(&addr), sizeof(addr)) < 0) {
+		//nobody to take over from:
+		std::cout << "[Server::take_over] no server waiting at " << path << "; starting fresh." << std::endl;
+		closesocket(s);
+		return false;
+	}
+	set_handoff_timeouts(s);
+	std::cout << "[Server::take_over] taking over from the server at " << path << "... "; std::cout.flush();
+
+	//if anything goes wrong part way, the old server keeps everything, so let go of whatever arrived:
+	auto fail = [&](std::string const &what) {
+		closesocket(s);
+		for (Socket *owned : {&listen_socket, &local_listen_socket}) {
+			if (*owned != InvalidSocket) closesocket(*owned);
+			*owned = InvalidSocket;
+		}
+		for (auto &c : connections) {
+			c.close();
+		}
+		connections.clear();
+		handoff_connection_state.clear();
+		throw std::runtime_error("Failed to take over from the server at '" + path + "': " + what);
+	};
+
+	HandoffHeader header;
+	listen_socket = recv_fd(s, &header, sizeof(header));
+	if (listen_socket == InvalidSocket || header.magic != HandoffMagic) fail("no listen socket");
+	if (header.has_local_listen) {
+		uint8_t byte = 0;
+		local_listen_socket = recv_fd(s, &byte, 1);
+		if (local_listen_socket == InvalidSocket) fail("no local listen socket");
+	}
+
+	for (uint32_t i = 0; i < header.connections; ++i) {
+		HandoffConnection info;
+		Socket got = recv_fd(s, &info, sizeof(info));
+		if (got == InvalidSocket) fail("connection " + std::to_string(i) + " missing");
+		connections.emplace_back();
+		Connection &c = connections.back();
+		c.socket = got;
+		std::vector< uint8_t > extra;
+		c.recv_buffer.resize(size_t(info.recv_size));
+		c.send_buffer.resize(size_t(info.send_size));
+		extra.resize(size_t(info.state_size));
+		if (!recv_all(s, c.recv_buffer.data(), c.recv_buffer.size())
+		 || !recv_all(s, c.send_buffer.data(), c.send_buffer.size())
+		 || !recv_all(s, extra.data(), extra.size())) {
+			fail("connection " + std::to_string(i) + " cut short");
+		}
+		handoff_connection_state.emplace_back(&c, std::move(extra));
+	}
+
+	handoff_state.resize(size_t(header.state_size));
+	if (!recv_all(s, handoff_state.data(), handoff_state.size())) fail("state cut short");
+
+	uint8_t ack = 'k';
+	if (!send_all(s, &ack, 1)) fail("couldn't confirm");
+	closesocket(s);
+
+	std::cout << "success! (" << connections.size() << " connections)" << std::endl;
+	return true;
+	#endif
+}
+
 void Server::poll(std::function< void(Connection *, Connection::Event event) > const &on_event, double timeout) {
-	poll_connections("Server::poll", connections, on_event, timeout, listen_socket);
+	//(re)arm each connection's deadline as it connects and talks:
+	auto arm_deadline = [this](Connection *c, double delay) {
+		if (c->timeout_timer && timers.reschedule(c->timeout_timer, delay)) return;
+		c->timeout_timer = timers.schedule(delay, [this,c](){
+			c->timeout_timer = 0;
+			timed_out.emplace_back(c);
+		});
+	};
+
+	auto track_event = [&](Connection *c, Connection::Event evt) {
+		if (evt == Connection::OnOpen) {
+			double deadline = (handshake_timeout > 0.0 ? handshake_timeout : idle_timeout);
+			if (deadline > 0.0) {
+				arm_deadline(c, deadline);
+			} else if (c->timeout_timer) { //(an outgoing connection's connect_timeout)
+				timers.cancel(c->timeout_timer);
+				c->timeout_timer = 0;
+			}
+		} else if (evt == Connection::OnRecv) {
+			if (idle_timeout > 0.0) {
+				arm_deadline(c, idle_timeout);
+			} else if (c->timeout_timer) {
+				timers.cancel(c->timeout_timer);
+				c->timeout_timer = 0;
+			}
+		}
+		if (on_event) on_event(c, evt);
+	};
+
+	//connections adopted from a previous server (see take_over) start out without a deadline:
+	if (idle_timeout > 0.0) {
+		for (auto &c : connections) {
+			if (c.socket != InvalidSocket && !c.timeout_timer) arm_deadline(&c, idle_timeout);
+		}
+	}
+
+	//don't sleep past the next timer:
+	timeout = timers.time_until_next(timeout);
+
+	poll_connections("Server::poll", connections, track_event, timeout, listen_socket, local_listen_socket, read_budget, recv_buffer_limit);
+
+	//fire timers, then close any connections that ran out of time:
+	timers.advance();
+	for (Connection *c : timed_out) {
+		if (c->socket == InvalidSocket) continue;
+		std::cerr << "[Server::poll] connection on " << c->socket << " timed out, disconnecting." << std::endl;
+		c->close();
+		if (on_event) on_event(c, Connection::OnClose);
+	}
+	timed_out.clear();
 
 	//reap closed clients:
 	for (auto connection = connections.begin(); connection != connections.end(); /*later*/) {
 		auto old = connection;
 		++connection;
 		if (old->socket == InvalidSocket) {
+			if (old->timeout_timer) timers.cancel(old->timeout_timer);
 			connections.erase(old);
 		}
 	}
 }
 
+Connection *Server::connect_to(std::string const &host, std::string const &port) {
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	struct addrinfo *res = nullptr;
+	int addrinfo_ret = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+	if (addrinfo_ret != 0) {
+		throw std::runtime_error("getaddrinfo error: " + std::string(gai_strerror(addrinfo_ret)));
+	}
+
+	//start connecting to the first address that takes it; poll() finds out how it went:
+	Socket s = InvalidSocket;
+	std::string err;
+	for (struct addrinfo *info = res; info != nullptr && s == InvalidSocket; info = info->ai_next) {
+		s = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+		if (s == InvalidSocket) {
+			err = strerror(errno);
+			continue;
+		}
+		#ifdef _WIN32
+		unsigned long one = 1;
+		bool started = (0 == ioctlsocket(s, FIONBIO, &one))
+			&& (::connect(s, info->ai_addr, int(info->ai_addrlen)) == 0 || WSAGetLastError() == WSAEWOULDBLOCK);
+		if (!started) err = "error " + std::to_string(WSAGetLastError());
+		#else
+		bool started = (fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK) == 0)
+			&& (::connect(s, info->ai_addr, socklen_t(info->ai_addrlen)) == 0 || errno == EINPROGRESS);
+		if (!started) err = strerror(errno);
+		#endif
+		if (!started) {
+			closesocket(s);
+			s = InvalidSocket;
+		}
+	}
+	freeaddrinfo(res);
+
+	if (s == InvalidSocket) {
+		throw std::runtime_error("Failed to start connecting to " + host + ":" + port + " (" + err + ").");
+	}
+
+	connections.emplace_back();
+	Connection *c = &connections.back();
+	c->socket = s;
+	c->connecting = true;
+	if (connect_timeout > 0.0) {
+		c->timeout_timer = timers.schedule(connect_timeout, [this,c](){
+			c->timeout_timer = 0;
+			timed_out.emplace_back(c);
+		});
+	}
+	return c;
+}
+
 Client::Client(std::string const &host, std::string const &port) : connections(1), connection(connections.front()) {
+	if (host.compare(0, 5, "unix:") == 0) {
+		#ifdef _WIN32
+		throw std::runtime_error("Shared-memory connections are not supported on this platform.");
+		#else
+		//connect to a local server's unix-domain socket and get shared-memory rings from it:
+		std::string path = host.substr(5);
+		std::cout << "[Client::Client] connecting to local socket " << path << "... "; std::cout.flush();
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (path.size() + 1 > sizeof(addr.sun_path)) {
+			throw std::runtime_error("Local socket path '" + path + "' is too long.");
+		}
+		memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+		Socket s = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (s == InvalidSocket || connect(s, reinterpret_cast< struct sockaddr * >(&addr), sizeof(addr)) < 0) {
+			std::string err = strerror(errno);
+			if (s != InvalidSocket) closesocket(s);
+			throw std::runtime_error("Failed to connect to local socket '" + path + "': " + err);
+		}
+		connection.shm = accept_shm_channel(s);
+		if (!connection.shm) {
+			closesocket(s);
+			throw std::runtime_error("Local server at '" + path + "' did not hand over shared memory.");
+		}
+		connection.socket = s;
+		std::cout << "success!" << std::endl;
+		return;
+		#endif
+	}
+
 	#ifdef _WIN32
 	{ //init winsock:
 		WSADATA info;
@@ -60,6 +60,8 @@ int main(int argc, char **argv) {
 #endif
 //--------- ---------------------------------- ---------
 
+#include "TimerWheel.hpp"
+
 #include <vector>
 #include <list>
 #include <string>
@@ -88,8 +90,15 @@ struct Connection {
 	//When the connection receives data, it is appended to recv_buffer:
 	std::vector< uint8_t > recv_buffer;
 
+	//Counters, handy for spotting misbehaving peers:
+	size_t recv_bytes = 0; //total bytes received
+	uint32_t throttled_polls = 0; //polls that stopped reading because of the read budget or recv_buffer limit
+
 	//internals:
 	Socket socket = InvalidSocket;
+	TimerWheel::TimerId timeout_timer = 0; //handshake / idle deadline (used by Server)
+	struct ShmChannel *shm = nullptr; //set for shared-memory connections; 'socket' is then a unix-domain socket used for wakeups
+	bool connecting = false; //outgoing connection (see Server::connect_to) that hasn't gone through yet
 
 	enum Event {
 		OnOpen,
@@ -99,7 +108,10 @@ struct Connection {
 };
 
 struct Server {
-	Server(std::string const &port); //pass the port number to listen on, as a string (servname, really)
+	//pass the port number to listen on, as a string (servname, really):
+	// if 'takeover_path' is given and a running server is waiting to hand off there (see below),
+	// its listen sockets and connections are adopted instead of binding 'port'
+	Server(std::string const &port, std::string const &takeover_path = "");
 
 	//poll() updates the list of active connections and sends/receives data if possible:
 	// (will wait up to 'timeout' for first event)
@@ -108,12 +120,62 @@ struct Server {
 		double timeout = 0.0 //timeout (seconds)
 	);
 
+	//Limits that keep one busy connection from hogging poll():
+	// (data past these limits stays in the socket and is read on a later poll)
+	size_t read_budget = 16384; //max bytes read from a single connection per poll (0 = no limit)
+	size_t recv_buffer_limit = 65536; //stop reading from a connection while its recv_buffer holds this much (0 = no limit)
+
+	//Connections that send nothing for handshake_timeout seconds after connecting, or that
+	// go quiet for idle_timeout seconds after that, are closed (0 = no limit):
+	double handshake_timeout = 0.0;
+	double idle_timeout = 0.0;
+
+	//Timers run by poll(); schedule game events here to have poll() wake up for them:
+	TimerWheel timers;
+	std::vector< Connection * > timed_out; //internal: connections whose deadline passed during timers.advance()
+
+	//start a connection out to host:port (e.g., another server) without waiting for it to go through:
+	// it is polled along with everything else, getting OnOpen once it is connected (anything put in its
+	// send_buffer before then is sent after) or OnClose if it fails or takes more than connect_timeout seconds
+	// (throws std::runtime_error if host:port can't be looked up or no socket can be made for it)
+	Connection *connect_to(std::string const &host, std::string const &port);
+	double connect_timeout = 1.0; //(0 = no limit)
+
+	//also accept clients on the same host through a unix-domain socket at 'path';
+	// their data then moves through shared memory instead of the network stack:
+	// (clients connect by passing "unix:<path>" as the host; not supported on windows)
+	void listen_local(std::string const &path);
+
+	//Restarting without dropping connections (not supported on windows):
+	// - the running server calls listen_handoff(path) once, then checks handoff_requested() every so often
+	//   (e.g., once per tick); it returns true once a new process has connected to 'path'
+	// - the running server then calls hand_off() with its game state; this passes the listen sockets and every
+	//   connection (with whatever is left in its buffers) to the new process. On success, the old process should
+	//   exit without touching its connections; on failure, it can keep running as if nothing had happened.
+	//   (shared-memory connections can't be passed along and are dropped)
+	// - the new process constructs its Server with the same path as 'takeover_path', then picks up the game
+	//   state from handoff_state and handoff_connection_state
+	void listen_handoff(std::string const &path);
+	bool handoff_requested();
+	bool hand_off(
+		std::vector< uint8_t > const &state,
+		std::function< std::vector< uint8_t >(Connection *) > const &connection_state = nullptr
+	);
+	std::vector< uint8_t > handoff_state; //game state passed along by the previous process
+	std::vector< std::pair< Connection *, std::vector< uint8_t > > > handoff_connection_state; //...and for each adopted connection
+
 	std::list< Connection > connections;
 	Socket listen_socket = InvalidSocket;
+	Socket local_listen_socket = InvalidSocket;
+	Socket handoff_listen_socket = InvalidSocket;
+	Socket handoff_socket = InvalidSocket; //new process waiting for hand_off()
+
+	bool take_over(std::string const &path); //internal: used by the constructor
 };
 
 
 struct Client {
+	//host may be "unix:<path>" to connect to a Server::listen_local socket (port is then ignored):
 	Client(std::string const &host, std::string const &port);
 
 	//poll() checks the status of the active connection and sends/receives data if possible:
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// Flow field toward one target on a width x height grid:
+//  a single breadth-first search from the target gives every tile its distance and the neighbor
+//  to step to next, so any number of agents heading for the same target share one search
+//  (instead of each running a path search of its own). Rebuild it when the target moves.
+//
+// For example:
+//
+//   FlowField field(BOARD_WIDTH, BOARD_HEIGHT);
+//   field.build(treasure_x, treasure_y);
+//   uint32_t next_x, next_y;
+//   field.step(bot_x, bot_y, &next_x, &next_y); // one tile closer to the treasure
+struct FlowField {
+    static constexpr uint16_t Unreachable = 0xffff;
+
+    FlowField(uint32_t width_, uint32_t height_)
+        : width(width_)
+        , height(height_)
+        , distances(size_t(width_) * height_, Unreachable)
+        , next(size_t(width_) * height_, 0)
+    {
+        queue.reserve(size_t(width) * height);
+    }
+
+    // point the field at (target_x, target_y); tiles where blocked(x, y) is true are never entered:
+    template <typename Blocked>
+    void build(uint32_t target_x_, uint32_t target_y_, Blocked const& blocked)
+    {
+        assert(target_x_ < width && target_y_ < height);
+        target_x = target_x_;
+        target_y = target_y_;
+        built = true;
+        std::fill(distances.begin(), distances.end(), Unreachable);
+
+        uint32_t target = index(target_x, target_y);
+        distances[target] = 0;
+        next[target] = target;
+        queue.clear();
+        queue.emplace_back(target);
+        // (the queue never shrinks; 'head' walks along it)
+        for (size_t head = 0; head < queue.size(); head++) {
+            uint32_t at = queue[head];
+            uint32_t x = at % width, y = at / width;
+            auto visit = [&](uint32_t nx, uint32_t ny) {
+                uint32_t n = index(nx, ny);
+                if (distances[n] != Unreachable || blocked(nx, ny))
+                    return;
+                distances[n] = uint16_t(distances[at] + 1);
+                next[n] = at; // (stepping from n to 'at' gets one tile closer)
+                queue.emplace_back(n);
+            };
+            if (x > 0)
+                visit(x - 1, y);
+            if (x + 1 < width)
+                visit(x + 1, y);
+            if (y > 0)
+                visit(x, y - 1);
+            if (y + 1 < height)
+                visit(x, y + 1);
+        }
+    }
+    void build(uint32_t target_x_, uint32_t target_y_)
+    {
+        build(target_x_, target_y_, [](uint32_t, uint32_t) { return false; });
+    }
+
+    // tiles to go from (x, y) to the target (Unreachable if there is no way there):
+    uint16_t distance(uint32_t x, uint32_t y) const
+    {
+        return distances[index(x, y)];
+    }
+
+    // the neighbor of (x, y) one tile closer to the target;
+    // returns false (and leaves *next_x, *next_y alone) at the target or if the target can't be reached:
+    bool step(uint32_t x, uint32_t y, uint32_t* next_x, uint32_t* next_y) const
+    {
+        uint32_t at = index(x, y);
+        if (distances[at] == 0 || distances[at] == Unreachable)
+            return false;
+        *next_x = next[at] % width;
+        *next_y = next[at] / width;
+        return true;
+    }
+
+    //-- internals --
+    uint32_t width, height;
+    bool built = false;
+    uint32_t target_x = 0, target_y = 0;
+    std::vector<uint16_t> distances; // per tile, row-major
+    std::vector<uint32_t> next; // per tile: index of the tile to step to
+    std::vector<uint32_t> queue; // (kept between builds so rebuilding doesn't allocate)
+
+    uint32_t index(uint32_t x, uint32_t y) const
+    {
+        assert(x < width && y < height);
+        return y * width + x;
+    }
+};
@@ -0,0 +1,507 @@
+#include "Game.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace {
+constexpr size_t InputRecordBytes = 4 + 1 + 1 + 1 + 4;
+constexpr size_t InputHeaderBytes = 1 + 1 + 4;
+constexpr size_t BoardHeaderBytes = 1 + 3;
+constexpr size_t BoardTickBytes = 4;
+
+void send_u32(Connection* connection, uint32_t v)
+{
+    connection->send(uint8_t(v >> 24));
+    connection->send(uint8_t((v >> 16) % 256));
+    connection->send(uint8_t((v >> 8) % 256));
+    connection->send(uint8_t(v % 256));
+}
+
+uint32_t read_u32(uint8_t const* at)
+{
+    return (uint32_t(at[0]) << 24) | (uint32_t(at[1]) << 16) | (uint32_t(at[2]) << 8) | uint32_t(at[3]);
+}
+
+void put_u32(std::vector<uint8_t>* out, uint32_t v)
+{
+    out->emplace_back(uint8_t(v >> 24));
+    out->emplace_back(uint8_t((v >> 16) % 256));
+    out->emplace_back(uint8_t((v >> 8) % 256));
+    out->emplace_back(uint8_t(v % 256));
+}
+
+void put_u64(std::vector<uint8_t>* out, uint64_t v)
+{
+    put_u32(out, uint32_t(v >> 32));
+    put_u32(out, uint32_t(v));
+}
+
+uint64_t read_u64(uint8_t const* at)
+{
+    return (uint64_t(read_u32(at)) << 32) | uint64_t(read_u32(at + 4));
+}
+
+void send_string(Connection* connection, std::string const& str)
+{
+    if (str.size() > 255) {
+        throw std::runtime_error("Name '" + str.substr(0, 32) + "...' is longer than 255 bytes.");
+    }
+    connection->send(uint8_t(str.size()));
+    connection->send_buffer.insert(connection->send_buffer.end(), str.begin(), str.end());
+}
+
+// reads (uint8 length) (bytes) starting at *at; returns false if it hasn't all arrived yet:
+bool read_string(std::vector<uint8_t> const& buffer, size_t* at, std::string* str)
+{
+    if (buffer.size() < *at + 1 || buffer.size() < *at + 1 + buffer[*at])
+        return false;
+    size_t length = buffer[*at];
+    str->assign(buffer.begin() + *at + 1, buffer.begin() + *at + 1 + length);
+    *at += 1 + length;
+    return true;
+}
+
+constexpr size_t BundleHeaderBytes = 1 + 4 + 1 + 2;
+constexpr size_t BundleEventBytes = 4 + 1 + 1 + 1 + 1;
+constexpr uint8_t BundleHasHash = 1;
+}
+
+void send_input_batch(Connection* connection, uint32_t timestamp_ms, std::deque<InputRecord> const& inputs)
+{
+    assert(connection);
+    assert(inputs.size() <= MaxInputBatch);
+
+    connection->send_buffer.reserve(connection->send_buffer.size() + InputHeaderBytes + inputs.size() * InputRecordBytes);
+    connection->send(Message::C2S_Inputs);
+    connection->send(uint8_t(inputs.size()));
+    send_u32(connection, timestamp_ms);
+    for (auto const& input : inputs) {
+        send_u32(connection, input.seq);
+        connection->send(input.pos_x);
+        connection->send(input.pos_y);
+        connection->send(input.enter);
+        send_u32(connection, input.seen_tick);
+    }
+}
+
+bool recv_input_batch(Connection* connection, uint32_t* timestamp_ms, std::vector<InputRecord>* inputs)
+{
+    assert(connection);
+    assert(inputs);
+    auto& recv_buffer = connection->recv_buffer;
+
+    if (recv_buffer.size() < InputHeaderBytes)
+        return false;
+    if (recv_buffer[0] != uint8_t(Message::C2S_Inputs))
+        return false;
+    size_t count = recv_buffer[1];
+    if (count == 0) {
+        throw std::runtime_error("Input batch with no inputs.");
+    }
+    size_t size = InputHeaderBytes + count * InputRecordBytes;
+    if (recv_buffer.size() < size)
+        return false;
+
+    if (timestamp_ms)
+        *timestamp_ms = read_u32(&recv_buffer[2]);
+
+    uint8_t const* at = &recv_buffer[InputHeaderBytes];
+    uint32_t prev_seq = 0;
+    for (size_t i = 0; i < count; i++, at += InputRecordBytes) {
+        InputRecord input;
+        input.seq = read_u32(at);
+        input.pos_x = at[4];
+        input.pos_y = at[5];
+        input.enter = at[6];
+        input.seen_tick = read_u32(at + 7);
+        if (input.seq <= prev_seq) {
+            throw std::runtime_error("Input batch with out-of-order sequence numbers.");
+        }
+        prev_seq = input.seq;
+        inputs->emplace_back(input);
+    }
+
+    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + size);
+    return true;
+}
+
+void send_board(Connection* connection, uint32_t tick, std::string const& board)
+{
+    assert(connection);
+    size_t size = BoardTickBytes + board.size();
+    assert(size < (1 << 24));
+
+    connection->send(Message::S2C_Board);
+    connection->send(uint8_t(size >> 16));
+    connection->send(uint8_t((size >> 8) % 256));
+    connection->send(uint8_t(size % 256));
+    send_u32(connection, tick);
+    connection->send_buffer.insert(connection->send_buffer.end(), board.begin(), board.end());
+}
+
+size_t board_message_length(std::vector<uint8_t> const& buffer)
+{
+    if (buffer.empty())
+        return 0;
+    if (buffer[0] != uint8_t(Message::S2C_Board)) {
+        throw std::runtime_error("Expected a board message, got message type '" + std::string(1, char(buffer[0])) + "'.");
+    }
+    if (buffer.size() < BoardHeaderBytes)
+        return 0;
+    size_t size = (size_t(buffer[1]) << 16) | (size_t(buffer[2]) << 8) | size_t(buffer[3]);
+    if (buffer.size() < BoardHeaderBytes + size)
+        return 0;
+    return BoardHeaderBytes + size;
+}
+
+bool recv_board(Connection* connection, uint32_t* tick, std::string* board)
+{
+    assert(connection);
+    auto& recv_buffer = connection->recv_buffer;
+
+    size_t length = board_message_length(recv_buffer);
+    if (length == 0)
+        return false;
+    if (length < BoardHeaderBytes + BoardTickBytes) {
+        throw std::runtime_error("Board message too short to hold a tick.");
+    }
+    if (tick)
+        *tick = read_u32(&recv_buffer[BoardHeaderBytes]);
+    if (board)
+        board->assign(recv_buffer.begin() + BoardHeaderBytes + BoardTickBytes, recv_buffer.begin() + length);
+
+    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + length);
+    return true;
+}
+
+void send_ping(Connection* connection, Message type, uint32_t id)
+{
+    assert(connection);
+    assert(type == Message::S2C_Ping || type == Message::C2S_Pong);
+    connection->send(type);
+    send_u32(connection, id);
+}
+
+bool recv_ping(Connection* connection, Message type, uint32_t* id)
+{
+    assert(connection);
+    auto& recv_buffer = connection->recv_buffer;
+    constexpr size_t PingBytes = 1 + 4;
+
+    if (recv_buffer.size() < PingBytes || recv_buffer[0] != uint8_t(type))
+        return false;
+    if (id)
+        *id = read_u32(&recv_buffer[1]);
+    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + PingBytes);
+    return true;
+}
+
+//------------ room clusters ------------
+
+void send_join(Connection* connection, std::string const& room)
+{
+    assert(connection);
+    connection->send(Message::C2S_Join);
+    send_string(connection, room);
+}
+
+void send_register(Connection* connection, std::string const& room, std::string const& host, std::string const& port)
+{
+    assert(connection);
+    connection->send(Message::S2R_Register);
+    send_string(connection, room);
+    send_string(connection, host);
+    send_string(connection, port);
+}
+
+void send_load(Connection* connection, uint32_t connections)
+{
+    assert(connection);
+    connection->send(Message::S2R_Load);
+    send_u32(connection, connections);
+}
+
+bool recv_join(Connection* connection, std::string* room)
+{
+    assert(connection);
+    auto& recv_buffer = connection->recv_buffer;
+    if (recv_buffer.empty() || recv_buffer[0] != uint8_t(Message::C2S_Join))
+        return false;
+    size_t at = 1;
+    std::string name;
+    if (!read_string(recv_buffer, &at, &name))
+        return false;
+    if (room)
+        *room = name;
+    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + at);
+    return true;
+}
+
+bool recv_register(Connection* connection, std::string* room, std::string* host, std::string* port)
+{
+    assert(connection);
+    auto& recv_buffer = connection->recv_buffer;
+    if (recv_buffer.empty() || recv_buffer[0] != uint8_t(Message::S2R_Register))
+        return false;
+    size_t at = 1;
+    std::string fields[3];
+    for (auto& field : fields) {
+        if (!read_string(recv_buffer, &at, &field))
+            return false;
+    }
+    if (room)
+        *room = fields[0];
+    if (host)
+        *host = fields[1];
+    if (port)
+        *port = fields[2];
+    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + at);
+    return true;
+}
+
+bool recv_load(Connection* connection, uint32_t* connections)
+{
+    assert(connection);
+    auto& recv_buffer = connection->recv_buffer;
+    constexpr size_t LoadBytes = 1 + 4;
+    if (recv_buffer.size() < LoadBytes || recv_buffer[0] != uint8_t(Message::S2R_Load))
+        return false;
+    if (connections)
+        *connections = read_u32(&recv_buffer[1]);
+    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + LoadBytes);
+    return true;
+}
+
+//------------ lockstep mode ------------
+
+void GameState::reset(uint64_t seed)
+{
+    tick = 0;
+    players.clear();
+    rng.state = seed;
+    treasure_x = uint8_t(rng.next() % (BOARD_WIDTH - 1));
+    treasure_y = uint8_t(rng.next() % (BOARD_HEIGHT - 1));
+    treasure_visible = true;
+    treasure_generation = 1;
+    respawn_tick = 0;
+}
+
+void GameState::apply(LockstepEvent const& event)
+{
+    if (event.type == LockstepEvent::Join) {
+        players[event.player] = Player();
+        return;
+    }
+    if (event.type == LockstepEvent::Leave) {
+        players.erase(event.player);
+        return;
+    }
+    auto f = players.find(event.player);
+    if (f == players.end())
+        return;
+    Player& player = f->second;
+    if (event.pos_x < BOARD_WIDTH && event.pos_y < BOARD_HEIGHT) {
+        player.pos_x = event.pos_x;
+        player.pos_y = event.pos_y;
+    }
+    if (event.enter && treasure_visible && player.pos_x == treasure_x && player.pos_y == treasure_y && player.dug_generation != treasure_generation) {
+        player.dug_generation = treasure_generation;
+        player.total += 1;
+        treasure_visible = false;
+        treasure_generation += 1;
+        respawn_tick = tick + TreasureRespawnTicks;
+    }
+}
+
+void GameState::step()
+{
+    tick += 1;
+    if (!treasure_visible && tick >= respawn_tick) {
+        // pop up somewhere else (never on the same row or column as the last spot):
+        uint8_t x, y;
+        do {
+            x = uint8_t(rng.next() % (BOARD_WIDTH - 1));
+            y = uint8_t(rng.next() % (BOARD_HEIGHT - 1));
+        } while (x == treasure_x || y == treasure_y);
+        treasure_x = x;
+        treasure_y = y;
+        treasure_visible = true;
+    }
+}
+
+uint64_t GameState::hash() const
+{
+    // FNV-1a over the saved state, which covers every field:
+    std::vector<uint8_t> data;
+    save(&data);
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (uint8_t b : data) {
+        h ^= b;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+std::string GameState::encode_board() const
+{
+    std::string board(BOARD_WIDTH * BOARD_HEIGHT, '\0');
+    for (auto const& [id, player] : players) {
+        (void)id;
+        if (player.pos_x < BOARD_WIDTH && player.pos_y < BOARD_HEIGHT) {
+            char& tile = board[player.pos_x + player.pos_y * BOARD_WIDTH];
+            if (tile < 127)
+                tile++;
+        }
+    }
+    if (treasure_visible) {
+        char& tile = board[treasure_x + treasure_y * BOARD_WIDTH];
+        tile = -tile;
+    }
+    return board;
+}
+
+void GameState::save(std::vector<uint8_t>* out) const
+{
+    assert(out);
+    put_u32(out, tick);
+    out->emplace_back(treasure_x);
+    out->emplace_back(treasure_y);
+    out->emplace_back(treasure_visible ? 1 : 0);
+    put_u32(out, treasure_generation);
+    put_u32(out, respawn_tick);
+    put_u64(out, rng.state);
+    put_u32(out, uint32_t(players.size()));
+    for (auto const& [id, player] : players) {
+        put_u32(out, id);
+        out->emplace_back(player.pos_x);
+        out->emplace_back(player.pos_y);
+        put_u32(out, uint32_t(player.total));
+        put_u32(out, player.dug_generation);
+    }
+}
+
+void GameState::load(uint8_t const* data, size_t size)
+{
+    constexpr size_t FixedBytes = 4 + 1 + 1 + 1 + 4 + 4 + 8 + 4;
+    constexpr size_t PlayerBytes = 4 + 1 + 1 + 4 + 4;
+    if (size < FixedBytes) {
+        throw std::runtime_error("Game state too short.");
+    }
+    uint8_t const* at = data;
+    tick = read_u32(at);
+    treasure_x = at[4];
+    treasure_y = at[5];
+    treasure_visible = (at[6] != 0);
+    treasure_generation = read_u32(at + 7);
+    respawn_tick = read_u32(at + 11);
+    rng.state = read_u64(at + 15);
+    uint32_t count = read_u32(at + 23);
+    at += FixedBytes;
+    if (size != FixedBytes + size_t(count) * PlayerBytes) {
+        throw std::runtime_error("Game state has the wrong size for its player count.");
+    }
+    players.clear();
+    for (uint32_t i = 0; i < count; i++, at += PlayerBytes) {
+        Player& player = players[read_u32(at)];
+        player.pos_x = at[4];
+        player.pos_y = at[5];
+        player.total = int32_t(read_u32(at + 6));
+        player.dug_generation = read_u32(at + 10);
+    }
+}
+
+void send_lockstep_start(Connection* connection, uint32_t player_id, GameState const& state)
+{
+    assert(connection);
+    std::vector<uint8_t> payload;
+    put_u32(&payload, player_id);
+    state.save(&payload);
+    assert(payload.size() < (1 << 24));
+
+    connection->send(Message::S2C_LockstepStart);
+    connection->send(uint8_t(payload.size() >> 16));
+    connection->send(uint8_t((payload.size() >> 8) % 256));
+    connection->send(uint8_t(payload.size() % 256));
+    connection->send_buffer.insert(connection->send_buffer.end(), payload.begin(), payload.end());
+}
+
+bool recv_lockstep_start(Connection* connection, uint32_t* player_id, GameState* state)
+{
+    assert(connection);
+    assert(state);
+    auto& recv_buffer = connection->recv_buffer;
+
+    if (recv_buffer.size() < 4 || recv_buffer[0] != uint8_t(Message::S2C_LockstepStart))
+        return false;
+    size_t size = (size_t(recv_buffer[1]) << 16) | (size_t(recv_buffer[2]) << 8) | size_t(recv_buffer[3]);
+    if (recv_buffer.size() < 4 + size)
+        return false;
+    if (size < 4) {
+        throw std::runtime_error("Lockstep start message too short.");
+    }
+    if (player_id)
+        *player_id = read_u32(&recv_buffer[4]);
+    state->load(&recv_buffer[8], size - 4);
+
+    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
+    return true;
+}
+
+void append_tick_bundle(std::vector<uint8_t>* out, uint32_t tick, std::vector<LockstepEvent> const& events, uint64_t const* hash)
+{
+    assert(out);
+    assert(events.size() < (1 << 16));
+    out->reserve(out->size() + BundleHeaderBytes + events.size() * BundleEventBytes + (hash ? 8 : 0));
+    out->emplace_back(uint8_t(Message::S2C_TickBundle));
+    put_u32(out, tick);
+    out->emplace_back(hash ? BundleHasHash : 0);
+    out->emplace_back(uint8_t(events.size() >> 8));
+    out->emplace_back(uint8_t(events.size() % 256));
+    for (auto const& event : events) {
+        put_u32(out, event.player);
+        out->emplace_back(uint8_t(event.type));
+        out->emplace_back(event.pos_x);
+        out->emplace_back(event.pos_y);
+        out->emplace_back(event.enter);
+    }
+    if (hash)
+        put_u64(out, *hash);
+}
+
+bool recv_tick_bundle(Connection* connection, uint32_t* tick, std::vector<LockstepEvent>* events, bool* has_hash, uint64_t* hash)
+{
+    assert(connection);
+    assert(events);
+    auto& recv_buffer = connection->recv_buffer;
+
+    if (recv_buffer.size() < BundleHeaderBytes || recv_buffer[0] != uint8_t(Message::S2C_TickBundle))
+        return false;
+    uint8_t flags = recv_buffer[5];
+    size_t count = (size_t(recv_buffer[6]) << 8) | size_t(recv_buffer[7]);
+    size_t size = BundleHeaderBytes + count * BundleEventBytes + ((flags & BundleHasHash) ? 8 : 0);
+    if (recv_buffer.size() < size)
+        return false;
+
+    if (tick)
+        *tick = read_u32(&recv_buffer[1]);
+    uint8_t const* at = &recv_buffer[BundleHeaderBytes];
+    for (size_t i = 0; i < count; i++, at += BundleEventBytes) {
+        LockstepEvent event;
+        event.player = read_u32(at);
+        event.type = LockstepEvent::Type(at[4]);
+        event.pos_x = at[5];
+        event.pos_y = at[6];
+        event.enter = at[7];
+        if (event.type != LockstepEvent::Join && event.type != LockstepEvent::Leave && event.type != LockstepEvent::Input) {
+            throw std::runtime_error("Tick bundle with an unknown event type.");
+        }
+        events->emplace_back(event);
+    }
+    if (has_hash)
+        *has_hash = (flags & BundleHasHash) != 0;
+    if (hash && (flags & BundleHasHash))
+        *hash = read_u64(at);
+
+    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + size);
+    return true;
+}
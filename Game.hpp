@@ -0,0 +1,183 @@
+#pragma once
+
+// Game.hpp holds the bits of Treasure Race that both the client and the server need:
+//  board dimensions, message types, and the encoding of the messages sent over a Connection.
+
+#include "Connection.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#define BOARD_WIDTH 10
+#define BOARD_HEIGHT 10
+
+// first byte of every message:
+enum class Message : uint8_t {
+    C2S_Inputs = 'i', // batch of timestamped inputs from a client
+    C2S_Spectate = 's', // no payload; turns the connection into a read-only board subscriber (repeated as a keepalive)
+    S2C_Board = 'm', // 24-bit size + server tick + board occupancy (one signed byte per tile; negative = treasure)
+    C2S_Resync = 'r', // lockstep mode: no payload; asks for a fresh snapshot
+    S2C_LockstepStart = 'L', // lockstep mode: 24-bit size + player id + snapshot
+    S2C_TickBundle = 't', // lockstep mode: one tick's events (+ periodic hash)
+    S2C_Ping = 'P', // ping id; the client answers right away with a pong
+    C2S_Pong = 'p', // ping id (echoed back)
+    C2S_Join = 'J', // room name; optional first message, lets ./router pick a server hosting that room
+    S2R_Register = 'R', // server -> router: room name + host and port to send that room's clients to
+    S2R_Load = 'l', // server -> router: number of connections the server is handling
+};
+
+// one sample of a client's input state:
+struct InputRecord {
+    uint32_t seq = 0; // counts up by one for every input the client produces (first input is 1)
+    uint8_t pos_x = 0;
+    uint8_t pos_y = 0;
+    uint8_t enter = 0; // dig
+    uint32_t seen_tick = 0; // server tick of the board the client was showing (lets the server judge digs by what the player saw)
+};
+
+// inputs that were already sent are repeated in the next batch this many times, so a dropped batch
+// (e.g., over a lossy relay) does not drop inputs with it:
+constexpr size_t InputRedundancy = 3;
+// the count field is one byte:
+constexpr size_t MaxInputBatch = 255;
+
+// input batch message:
+//  'i' (uint8 count) (uint32 timestamp ms) count * [ (uint32 seq) (uint8 x) (uint8 y) (uint8 enter) (uint32 seen tick) ]
+// inputs are sent oldest-first; timestamp is the client's clock when the batch was sent
+void send_input_batch(Connection* connection, uint32_t timestamp_ms, std::deque<InputRecord> const& inputs);
+
+// returns false if recv_buffer doesn't start with a complete input batch (inputs are left untouched);
+// otherwise consumes the message, appends its inputs, and returns true.
+// throws std::runtime_error on a malformed batch.
+bool recv_input_batch(Connection* connection, uint32_t* timestamp_ms, std::vector<InputRecord>* inputs);
+
+// board message:
+//  'm' (uint24 size) (uint32 tick) (size - 4) * [ (int8 tile) ]
+void send_board(Connection* connection, uint32_t tick, std::string const& board);
+
+// returns false if recv_buffer doesn't start with a complete board message;
+// otherwise consumes the message, stores its tick and tiles, and returns true.
+// throws std::runtime_error if recv_buffer starts with some other message.
+bool recv_board(Connection* connection, uint32_t* tick, std::string* board);
+
+// returns the length of the complete board message at the front of 'buffer', or 0 if it hasn't all arrived yet
+// (the message is left in the buffer, so it can be forwarded as-is).
+// throws std::runtime_error if 'buffer' starts with some other message.
+size_t board_message_length(std::vector<uint8_t> const& buffer);
+
+// ping and pong messages (the server measures each player's round-trip time with these):
+//  'P' or 'p' (uint32 ping id)
+void send_ping(Connection* connection, Message type, uint32_t id);
+
+// returns false if recv_buffer doesn't start with a complete message of 'type';
+// otherwise consumes the message, stores its id, and returns true.
+bool recv_ping(Connection* connection, Message type, uint32_t* id);
+
+//------------ room clusters ------------
+// ./router spreads clients over several servers (see router.cpp). Servers started with --router
+// register once and then report their load every second; clients may name a room first:
+//  'J' (uint8 length) (room name)
+//  'R' (uint8 length) (room name) (uint8 length) (host) (uint8 length) (port)
+//  'l' (uint32 connections)
+// (names are at most 255 bytes; longer ones throw std::runtime_error when sent)
+
+// clients that don't name a room (and servers that aren't told theirs) are in this one:
+constexpr char const* DefaultRoom = "main";
+
+void send_join(Connection* connection, std::string const& room);
+void send_register(Connection* connection, std::string const& room, std::string const& host, std::string const& port);
+void send_load(Connection* connection, uint32_t connections);
+
+// each returns false if recv_buffer doesn't start with a complete message of its type;
+// otherwise consumes the message, stores its fields, and returns true:
+bool recv_join(Connection* connection, std::string* room);
+bool recv_register(Connection* connection, std::string* room, std::string* host, std::string* port);
+bool recv_load(Connection* connection, uint32_t* connections);
+
+//------------ lockstep mode ------------
+// In lockstep mode (./server --lockstep) the server doesn't send boards; every peer runs the same
+// deterministic GameState and the server relays what happened each tick as a bundle of events.
+// Bundles scale with the number of inputs rather than with the size of the board.
+//
+// messages:
+//  'L' (uint24 size) (uint32 your player id; 0 = spectating) (saved GameState)
+//     -- sent when a client joins (or asks for a resync); bundles after this one start from its tick
+//  't' (uint32 tick) (uint8 flags) (uint16 count) count * [ (uint32 player) (uint8 type) (uint8 x) (uint8 y) (uint8 enter) ] [ (uint64 hash) ]
+//     -- events to apply at the start of 'tick', then step; the hash (present if flags & 1) is GameState::hash() after the step
+//  'r' -- from a client whose hash didn't match; the server answers with a fresh 'L'
+
+// random numbers that come out the same on every platform (splitmix64):
+struct GameRng {
+    uint64_t state = 0;
+    uint32_t next()
+    {
+        state += 0x9e3779b97f4a7c15ull;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return uint32_t((z ^ (z >> 31)) >> 32);
+    }
+};
+
+struct LockstepEvent {
+    enum Type : uint8_t {
+        Join = 'j',
+        Leave = 'l',
+        Input = 'i',
+    };
+    uint32_t player = 0;
+    Type type = Input;
+    uint8_t pos_x = 0;
+    uint8_t pos_y = 0;
+    uint8_t enter = 0;
+};
+
+struct GameState {
+    // a dug treasure stays hidden this many ticks:
+    static constexpr uint32_t TreasureRespawnTicks = 15;
+
+    struct Player {
+        uint8_t pos_x = 0xff; // (off the board until the first input)
+        uint8_t pos_y = 0xff;
+        int32_t total = 0;
+        uint32_t dug_generation = 0;
+    };
+
+    uint32_t tick = 0;
+    std::map<uint32_t, Player> players; // by id (ordered, so every peer visits them the same way)
+    uint8_t treasure_x = 0;
+    uint8_t treasure_y = 0;
+    bool treasure_visible = true;
+    uint32_t treasure_generation = 1;
+    uint32_t respawn_tick = 0; // tick at which a dug treasure comes back
+    GameRng rng;
+
+    // start a new game:
+    void reset(uint64_t seed);
+    // something happened this tick (call before step()):
+    void apply(LockstepEvent const& event);
+    // advance to the next tick:
+    void step();
+
+    // fingerprint of everything above, for spotting desyncs:
+    uint64_t hash() const;
+    // board encoded the same way as the board message (so the client draws it the same way):
+    std::string encode_board() const;
+
+    void save(std::vector<uint8_t>* out) const;
+    // throws std::runtime_error on malformed data:
+    void load(uint8_t const* data, size_t size);
+};
+
+void send_lockstep_start(Connection* connection, uint32_t player_id, GameState const& state);
+// returns false if recv_buffer doesn't start with a complete 'L' message; otherwise consumes it and returns true:
+bool recv_lockstep_start(Connection* connection, uint32_t* player_id, GameState* state);
+
+// bundles are encoded once and then copied to every connection:
+void append_tick_bundle(std::vector<uint8_t>* out, uint32_t tick, std::vector<LockstepEvent> const& events, uint64_t const* hash);
+// returns false if recv_buffer doesn't start with a complete 't' message; otherwise consumes it, appends its events,
+// and returns true (*has_hash says whether the bundle carried a hash):
+bool recv_tick_bundle(Connection* connection, uint32_t* tick, std::vector<LockstepEvent>* events, bool* has_hash, uint64_t* hash);
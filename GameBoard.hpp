@@ -1,98 +1,38 @@
 #pragma once
 
-#include "gl_compile_program.hpp"
+#include "GameBoardHeatProgram.hpp"
+#include "GameBoardProgram.hpp"
+#include "GameBoardTextureProgram.hpp"
+#include "OccupancyPyramid.hpp"
 #include "gl_errors.hpp"
 #include <glm/glm.hpp>
-#include <glm/gtx/string_cast.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <string>
 #include <vector>
 
 // got rendering help from: https://learnopengl.com/Getting-started/Hello-Triangle
+// (tiles are plain data, kept in one flat array by GameBoard; a tile's position is its index in it)
 struct Tile {
     int num_over = 0;
-    int delta = 0;
+    int delta = 0; // num_over before its last change minus num_over after it
+    float changed_at = -1.0e6f; // when num_over last changed (on GameBoard::now()'s clock)
     inline static size_t max_over = 1; // how to determine when a tile is white (maximally coloured)
     bool treasure = false;
 
-    constexpr static glm::vec2 block_size = glm::vec2(0.1, 0.1);
-
-    // for indexing
-    inline static size_t static_tile_index = 0;
-    const glm::ivec2 pos;
-    size_t tile_id = 0;
-
     // for drawing
-    inline static GLuint draw_program = 0;
-    GLuint VAO = 0;
-    GLuint VBO = 0;
-    glm::vec4 colour;
+    glm::vec4 colour = glm::vec4(0.f, 0.f, 0.f, 1.f);
     bool colour_other = true;
+    bool dirty = false; // changed since the last draw (see GameBoard::mark_dirty)
 
-    Tile(const glm::vec2& p)
-        : pos(p)
-    {
-        tile_id = static_tile_index;
-        static_tile_index++;
-
-        std::cout << "constructed tile at: " << glm::to_string(p) << std::endl;
-
-        // create shaders for rendering
-        {
-            const auto vertex_shader = "#version 330 core\n"
-                                       "layout (location = 0) in vec3 vertex;\n"
-                                       "void main()\n"
-                                       "{\n"
-                                       "    gl_Position = vec4(vertex.xyz, 1.0);\n"
-                                       "}\n";
-
-            const auto fragment_shader = "#version 330 core\n"
-                                         "out vec4 color;\n"
-                                         "uniform vec4 colour;\n"
-                                         "void main()\n"
-                                         "{\n"
-                                         "   color = colour;\n"
-                                         "}\n";
-            if (Tile::draw_program == 0) {
-                Tile::draw_program = gl_compile_program(vertex_shader, fragment_shader);
-            }
-
-            // initialize vertex buffer (what data is sent to the GPU)
-            float vertices[] = {
-                // first triangle
-                -0.5f + block_size.x * pos.x, 0.5f - block_size.y * pos.y, 0.0f, // top right
-                -0.5f + block_size.x * pos.x, 0.5f - block_size.y * (pos.y + 1), 0.0f, // bottom right
-                -0.5f + block_size.x * (pos.x + 1), 0.5f - block_size.y * (pos.y + 1), 0.0f, // top left
-                // second triangle
-                -0.5f + block_size.x * pos.x, 0.5f - block_size.y * pos.y, 0.0f, // bottom right
-                -0.5f + block_size.x * (pos.x + 1), 0.5f - block_size.y * pos.y, 0.0f, // bottom left
-                -0.5f + block_size.x * (pos.x + 1), 0.5f - block_size.y * (pos.y + 1), 0.0f, // top left
-            };
-
-            // init arrays
-            glGenVertexArrays(1, &VAO);
-            glGenBuffers(1, &VBO);
-
-            // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-            glBindVertexArray(VAO);
-
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-            // set the vertex attributes pointers
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-            glEnableVertexAttribArray(0);
-
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-            glBindVertexArray(0);
-
-            // glBindVertexArray(0);
-            GL_ERRORS();
-        }
-    }
-
-    void draw()
+    // bring 'colour' up to date with the tile's state (unless something else picked it):
+    glm::vec4 const& update_colour()
     {
-        glUseProgram(Tile::draw_program);
         if (colour_other) {
             float lum = num_over / static_cast<float>(max_over);
             colour = glm::vec4(lum, lum, lum, 1.0);
@@ -100,53 +40,567 @@ struct Tile {
         if (treasure) {
             colour = glm::vec4(1.f, 1.f, 0.f, 1.f);
         }
-        // send colour to shader
-        glUniform4f(glGetUniformLocation(Tile::draw_program, "colour"), colour.x, colour.y, colour.z, colour.w);
-        glBindVertexArray(VAO);
+        return colour;
+    }
+};
 
-        glDrawArrays(GL_TRIANGLES, 0, 6); // 2 triangles => quad
+// 2D camera over a board, in tiles (x to the right, y down; tile (x, y) covers [x, x+1] x [y, y+1]):
+struct BoardCamera {
+    glm::vec2 center = glm::vec2(0.0f);
+    float view_height = 12.0f; // tiles visible from the top of the screen to the bottom
+    static constexpr float MinViewHeight = 3.0f;
+    static constexpr float MaxViewHeight = 4096.0f;
 
-        GL_ERRORS();
+    void zoom(float factor)
+    {
+        view_height = std::clamp(view_height * factor, MinViewHeight, MaxViewHeight);
+    }
+
+    // clip = tile * scale + offset, packed as (scale.x, scale.y, offset.x, offset.y):
+    glm::vec4 tile_to_clip(float aspect) const
+    {
+        float s = 2.0f / view_height;
+        return glm::vec4(s / aspect, -s, -center.x * s / aspect, center.y * s);
     }
+
+    // corners of the view, in tiles:
+    glm::vec2 view_min(float aspect) const { return center - 0.5f * glm::vec2(view_height * aspect, view_height); }
+    glm::vec2 view_max(float aspect) const { return center + 0.5f * glm::vec2(view_height * aspect, view_height); }
 };
 
+// The board is drawn in one of two ways:
+//  - Instanced: one unit quad, placed once per tile from a per-instance buffer of tile positions
+//    and colours. The instances are grouped into ChunkSize x ChunkSize chunks, and each frame
+//    only the chunks in the camera's view are drawn (one instanced draw call per chunk).
+//  - Texture: tile states live in an integer texture (one texel per tile) and one quad covers
+//    the part of the board in view, with the fragment shader looking up each pixel's tile; only
+//    the rows that changed since the last frame are re-uploaded. This is the one for very large
+//    boards, where even a per-instance buffer is a lot of data to rebuild and push every frame.
+// Changes in a tile's shade fade in over FadeTime. Each tile's change time and delta are uploaded
+// once, when it changes, and the shaders animate the fade from a time uniform, so an animating
+// board costs no more CPU time per frame than a still one.
+// Either way only tiles marked dirty are looked at when drawing: apply() marks the tiles a
+// new board message changed, and whoever else changes a tile calls mark_dirty() on it.
+// Zoomed out far enough that tiles would be smaller than MinTilePixels, neither is used: the
+// board is drawn as a heatmap of cells from an OccupancyPyramid level instead (see draw_heat).
 struct GameBoard {
-    GameBoard(const glm::ivec2& s)
-        : shape(s)
+    enum class Rendering {
+        Auto, // Texture for boards of at least TextureThreshold tiles, Instanced otherwise
+        Instanced,
+        Texture,
+    };
+    static constexpr size_t TextureThreshold = 256 * 256;
+    static constexpr int ChunkSize = 32;
+    static constexpr float MinTilePixels = 2.0f;
+    static constexpr float FadeTime = 0.5f; // seconds
+
+    // per-instance attributes, as laid out in instance_buffer:
+    struct TileInstance {
+        glm::vec2 position; // (x, y) of the tile
+        glm::vec4 colour;
+        glm::vec2 change; // (changed_at, how much brighter the tile was before the change)
+    };
+
+    // a block of tiles whose instances are contiguous in instance_buffer:
+    struct Chunk {
+        glm::ivec2 min, max; // tiles [min, max)
+        uint32_t first = 0; // first instance
+    };
+
+    // texel layout of change_texture (GL_RG32F):
+    struct TileChange {
+        float changed_at = -1.0e6f;
+        float delta = 0.0f; // (as in Tile)
+        bool operator==(TileChange const& other) const { return changed_at == other.changed_at && delta == other.delta; }
+        bool operator!=(TileChange const& other) const { return !(*this == other); }
+    };
+
+    // texel layout of tile_texture (GL_RG8I):
+    struct TileTexel {
+        int8_t over = 0; // explorers on the tile (capped at 127)
+        int8_t flags = 0;
+        enum : int8_t { Treasure = 1, Override = 2 }; // (override = drawn in the tile's own colour)
+        bool operator==(TileTexel const& other) const { return over == other.over && flags == other.flags; }
+        bool operator!=(TileTexel const& other) const { return !(*this == other); }
+    };
+
+    // (tile state is allocated once, up front, and the GPU side is created once for the whole board
+    //  and filled in the same pass, so even a 1024x1024 board is quick to set up)
+    GameBoard(const glm::ivec2& s, Rendering rendering_ = Rendering::Auto)
+        : board(size_t(s.x) * s.y)
+        , shape(s)
+        , rendering(rendering_)
+        , pyramid(uint32_t(s.x), uint32_t(s.y))
     {
-        // board.resize(shape.x * shape.y);
-        for (int i = 0; i < shape.x * shape.y; i++) {
-            board.push_back(Tile({ i % shape.x, i / shape.x }));
+        if (rendering == Rendering::Auto) {
+            rendering = (board.size() >= TextureThreshold ? Rendering::Texture : Rendering::Instanced);
+        }
+        camera.center = 0.5f * glm::vec2(shape);
+
+        // the quad everything is drawn with, as two triangles:
+        const glm::vec2 quad[] = {
+            { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f },
+            { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f },
+        };
+        glGenBuffers(1, &quad_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, quad_buffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        if (rendering == Rendering::Texture) {
+            create_texture_resources();
+        } else {
+            create_instanced_resources();
         }
+        create_heat_resources();
+        drawn_max_over = Tile::max_over;
+
+        GL_ERRORS();
     }
 
+    ~GameBoard()
+    {
+        glDeleteVertexArrays(1, &heat_vertex_array);
+        glDeleteTextures(GLsizei(heat_textures.size()), heat_textures.data());
+        glDeleteTextures(1, &change_texture);
+        glDeleteTextures(1, &tile_texture);
+        glDeleteVertexArrays(1, &vertex_array);
+        glDeleteBuffers(1, &instance_buffer);
+        glDeleteBuffers(1, &quad_buffer);
+    }
+
+    GameBoard(GameBoard const&) = delete;
+    GameBoard& operator=(GameBoard const&) = delete;
+
     std::vector<Tile> board;
     const glm::ivec2 shape;
+    Rendering rendering; // (never Auto once constructed)
+    BoardCamera camera;
+    uint32_t drawn_chunks = 0; // (Instanced) chunks in view at the last draw
+    uint32_t drawn_level = 0; // pyramid level drawn at the last draw (0 = tiles)
+    OccupancyPyramid pyramid; // kept up to date by apply()
 
     Tile& GetTile(const glm::ivec2& pos)
     {
-        size_t index = pos.x + pos.y * shape.y;
-        return board[index];
+        return board[index(pos)];
+    }
+    size_t index(const glm::ivec2& pos) const
+    {
+        return size_t(pos.x) + size_t(pos.y) * shape.x;
+    }
+    size_t index(Tile const& tile) const
+    {
+        return size_t(&tile - board.data());
     }
 
     void reset()
     {
         for (auto& t : board) {
             t.num_over = 0;
+            t.treasure = false;
+        }
+        pyramid.clear();
+        applied.clear();
+        mark_all_dirty();
+    }
+
+    // bring the tiles up to date with a board message (as encoded by GameState::encode_board),
+    // touching only the tiles whose byte differs from the last message applied:
+    void apply(std::string const& message)
+    {
+        float time = now();
+        size_t count = std::min(message.size(), board.size());
+        applied.resize(count, '\0');
+        for (size_t i = 0; i < count; i++) {
+            if (message[i] == applied[i])
+                continue;
+            applied[i] = message[i];
+            int new_num_over = std::abs(int(int8_t(message[i])));
+            bool new_treasure = (message[i] < 0); // treasure located if server message < 0
+            pyramid.add(uint32_t(i % shape.x), uint32_t(i / shape.x), new_num_over - board[i].num_over, int32_t(new_treasure) - int32_t(board[i].treasure));
+            if (new_num_over != board[i].num_over) {
+                board[i].delta = board[i].num_over - new_num_over;
+                board[i].changed_at = time;
+            }
+            board[i].num_over = new_num_over;
+            board[i].treasure = new_treasure;
+            mark_dirty(board[i]);
+        }
+    }
+
+    // 'tile' needs redrawing (call after changing it):
+    void mark_dirty(Tile& tile)
+    {
+        if (tile.dirty)
+            return;
+        tile.dirty = true;
+        dirty_tiles.emplace_back(uint32_t(index(tile)));
+    }
+    void mark_all_dirty()
+    {
+        for (auto& tile : board) {
+            mark_dirty(tile);
         }
     }
 
     void draw(const glm::vec2& drawable_size)
     {
-        // glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        // glClear(GL_COLOR_BUFFER_BIT);
+        float aspect = float(drawable_size.x) / float(drawable_size.y);
+
+        if (rendering == Rendering::Instanced && drawn_max_over != Tile::max_over) {
+            // (every tile's shade depends on it)
+            drawn_max_over = Tile::max_over;
+            mark_all_dirty();
+        }
+        // keep track of the tile drawn in its own colour (the player's), which every path shows:
+        for (uint32_t i : dirty_tiles) {
+            if (!board[i].colour_other) {
+                override_tile = int32_t(i);
+                override_colour = board[i].colour;
+            } else if (override_tile == int32_t(i)) {
+                override_tile = -1;
+            }
+        }
 
-        // glDisable(GL_DEPTH_TEST);
-        // float aspect = float(drawable_size.x) / float(drawable_size.y);
+        // bring the tile renderer's copy up to date whether or not it draws this frame,
+        // so zooming back in doesn't have to catch up on everything at once:
+        if (rendering == Rendering::Texture) {
+            update_texels();
+        } else {
+            update_instances();
+        }
+        for (uint32_t i : dirty_tiles) {
+            board[i].dirty = false;
+        }
+        dirty_tiles.clear();
 
-        for (int i = 0; i < board.size(); i++) {
-            board[i].draw();
+        // once tiles get too small to see, draw the finest pyramid level whose cells are at least MinTilePixels:
+        float tile_pixels = float(drawable_size.y) / camera.view_height;
+        drawn_level = 0;
+        while (tile_pixels * float(1u << drawn_level) < MinTilePixels && drawn_level < pyramid.level_count()) {
+            drawn_level += 1;
         }
+        if (drawn_level > 0) {
+            drawn_chunks = 0;
+            draw_heat(aspect, drawn_level);
+        } else if (rendering == Rendering::Texture) {
+            draw_texture(aspect);
+        } else {
+            draw_instanced(aspect);
+        }
+
         GL_ERRORS();
     }
+
+    // seconds since the board was created (the clock tile changes are timed on):
+    float now() const
+    {
+        return std::chrono::duration<float>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    //-- internals --
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    std::string applied; // last board message apply()'d
+    std::vector<uint32_t> dirty_tiles; // indices of tiles marked dirty since the last draw
+    int32_t override_tile = -1; // tile drawn in its own colour (-1 = none)
+    glm::vec4 override_colour = glm::vec4(0.f, 0.f, 1.f, 1.f); // (the board only ever overrides one tile: the player's own)
+    size_t drawn_max_over = 0; // Tile::max_over as of the last draw
+    GLuint quad_buffer = 0;
+    GLuint vertex_array = 0;
+
+    // Rendering::Instanced:
+    std::vector<TileInstance> instances; // per tile, grouped by chunk
+    std::vector<Chunk> chunks; // row-major
+    glm::ivec2 chunk_count = glm::ivec2(0);
+    GLuint instance_buffer = 0;
+
+    // index in 'instances' of tile 'i':
+    uint32_t instance_of(size_t i) const
+    {
+        int x = int(i % shape.x), y = int(i / shape.x);
+        Chunk const& chunk = chunks[size_t(y / ChunkSize) * chunk_count.x + x / ChunkSize];
+        return chunk.first + uint32_t((y - chunk.min.y) * (chunk.max.x - chunk.min.x) + (x - chunk.min.x));
+    }
+
+    void create_instanced_resources()
+    {
+        chunk_count = glm::ivec2((shape.x + ChunkSize - 1) / ChunkSize, (shape.y + ChunkSize - 1) / ChunkSize);
+        chunks.resize(size_t(chunk_count.x) * chunk_count.y);
+        instances.resize(board.size());
+        uint32_t next = 0;
+        for (int cy = 0; cy < chunk_count.y; cy++) {
+            for (int cx = 0; cx < chunk_count.x; cx++) {
+                Chunk& chunk = chunks[size_t(cy) * chunk_count.x + cx];
+                chunk.min = glm::ivec2(cx * ChunkSize, cy * ChunkSize);
+                chunk.max = glm::ivec2(std::min(shape.x, chunk.min.x + ChunkSize), std::min(shape.y, chunk.min.y + ChunkSize));
+                chunk.first = next;
+                for (int y = chunk.min.y; y < chunk.max.y; y++) {
+                    for (int x = chunk.min.x; x < chunk.max.x; x++, next++) {
+                        Tile& tile = board[index(glm::ivec2(x, y))];
+                        instances[next].position = glm::vec2(x, y);
+                        instances[next].colour = tile.update_colour();
+                        instances[next].change = change_of(tile);
+                    }
+                }
+            }
+        }
+
+        glGenBuffers(1, &instance_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(TileInstance), instances.data(), GL_DYNAMIC_DRAW);
+
+        glGenVertexArrays(1, &vertex_array);
+        glBindVertexArray(vertex_array);
+
+        glBindBuffer(GL_ARRAY_BUFFER, quad_buffer);
+        glVertexAttribPointer(game_board_program->Corner_vec2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (GLbyte*)0);
+        glEnableVertexAttribArray(game_board_program->Corner_vec2);
+
+        glEnableVertexAttribArray(game_board_program->Position_vec2);
+        glVertexAttribDivisor(game_board_program->Position_vec2, 1);
+        glEnableVertexAttribArray(game_board_program->Color_vec4);
+        glVertexAttribDivisor(game_board_program->Color_vec4, 1);
+        glEnableVertexAttribArray(game_board_program->Change_vec2);
+        glVertexAttribDivisor(game_board_program->Change_vec2, 1);
+        point_instances(0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    // point the per-instance attributes at instances[first...]:
+    // (GL 3.3 has no base-instance draws, so each chunk's draw moves the pointers instead)
+    void point_instances(uint32_t first)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+        GLbyte* base = (GLbyte*)0 + first * sizeof(TileInstance);
+        glVertexAttribPointer(game_board_program->Position_vec2, 2, GL_FLOAT, GL_FALSE, sizeof(TileInstance), base + offsetof(TileInstance, position));
+        glVertexAttribPointer(game_board_program->Color_vec4, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), base + offsetof(TileInstance, colour));
+        glVertexAttribPointer(game_board_program->Change_vec2, 2, GL_FLOAT, GL_FALSE, sizeof(TileInstance), base + offsetof(TileInstance, change));
+    }
+
+    // per-instance change attribute for 'tile' (only plain shaded tiles fade):
+    static glm::vec2 change_of(Tile const& tile)
+    {
+        bool shaded = tile.colour_other && !tile.treasure;
+        return glm::vec2(tile.changed_at, shaded ? tile.delta / static_cast<float>(Tile::max_over) : 0.0f);
+    }
+
+    void update_instances()
+    {
+        // recolour the dirty tiles and upload the span of instances that covers them:
+        uint32_t first = uint32_t(instances.size()), last = 0;
+        for (uint32_t i : dirty_tiles) {
+            uint32_t at = instance_of(i);
+            instances[at].colour = board[i].update_colour();
+            instances[at].change = change_of(board[i]);
+            first = std::min(first, at);
+            last = std::max(last, at);
+        }
+        if (first <= last) {
+            glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(TileInstance), (last - first + 1) * sizeof(TileInstance), &instances[first]);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    }
+
+    void draw_instanced(float aspect)
+    {
+        // chunks overlapping the view (only these are visited at all):
+        glm::vec2 view_min = camera.view_min(aspect), view_max = camera.view_max(aspect);
+        int cx0 = std::max(0, int(std::floor(view_min.x / ChunkSize)));
+        int cy0 = std::max(0, int(std::floor(view_min.y / ChunkSize)));
+        int cx1 = std::min(chunk_count.x, int(std::floor(view_max.x / ChunkSize)) + 1);
+        int cy1 = std::min(chunk_count.y, int(std::floor(view_max.y / ChunkSize)) + 1);
+
+        glm::vec4 tile_to_clip = camera.tile_to_clip(aspect);
+        glUseProgram(game_board_program->program);
+        glUniform4f(game_board_program->TILE_TO_CLIP_vec4, tile_to_clip.x, tile_to_clip.y, tile_to_clip.z, tile_to_clip.w);
+        glUniform1f(game_board_program->TIME_float, now());
+        glUniform1f(game_board_program->FADE_TIME_float, FadeTime);
+        glBindVertexArray(vertex_array);
+        drawn_chunks = 0;
+        for (int cy = cy0; cy < cy1; cy++) {
+            for (int cx = cx0; cx < cx1; cx++) {
+                Chunk const& chunk = chunks[size_t(cy) * chunk_count.x + cx];
+                glm::ivec2 size = chunk.max - chunk.min;
+                point_instances(chunk.first);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, 6, GLsizei(size.x * size.y));
+                drawn_chunks += 1;
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+
+    // Rendering::Texture:
+    std::vector<TileTexel> texels; // what tile_texture holds, per tile, same order as 'board'
+    std::vector<TileChange> changes; // what change_texture holds, likewise
+    GLuint tile_texture = 0;
+    GLuint change_texture = 0;
+
+    static TileTexel texel_of(Tile const& tile)
+    {
+        TileTexel texel;
+        texel.over = int8_t(std::min(tile.num_over, 127));
+        texel.flags = int8_t((tile.treasure ? TileTexel::Treasure : 0) | (tile.colour_other ? 0 : TileTexel::Override));
+        return texel;
+    }
+
+    void create_texture_resources()
+    {
+        texels.assign(board.size(), texel_of(Tile()));
+        changes.assign(board.size(), TileChange());
+
+        glGenTextures(1, &tile_texture);
+        glBindTexture(GL_TEXTURE_2D, tile_texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // (rows are 2 * shape.x bytes)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8I, shape.x, shape.y, 0, GL_RG_INTEGER, GL_BYTE, texels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        // (integer textures can't be filtered)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+        glGenTextures(1, &change_texture);
+        glBindTexture(GL_TEXTURE_2D, change_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, shape.x, shape.y, 0, GL_RG, GL_FLOAT, changes.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenVertexArrays(1, &vertex_array);
+        glBindVertexArray(vertex_array);
+        glBindBuffer(GL_ARRAY_BUFFER, quad_buffer);
+        glVertexAttribPointer(game_board_texture_program->Corner_vec2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (GLbyte*)0);
+        glEnableVertexAttribArray(game_board_texture_program->Corner_vec2);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    void update_texels()
+    {
+        // find the rows with changed texels and upload just those:
+        int first_row = shape.y, last_row = -1;
+        for (uint32_t i : dirty_tiles) {
+            TileTexel texel = texel_of(board[i]);
+            TileChange change;
+            change.changed_at = board[i].changed_at;
+            change.delta = float(board[i].delta);
+            if (texel != texels[i] || change != changes[i]) {
+                texels[i] = texel;
+                changes[i] = change;
+                int row = int(i / shape.x);
+                first_row = std::min(first_row, row);
+                last_row = std::max(last_row, row);
+            }
+        }
+        if (first_row <= last_row) {
+            glBindTexture(GL_TEXTURE_2D, tile_texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, shape.x, last_row - first_row + 1, GL_RG_INTEGER, GL_BYTE, &texels[size_t(first_row) * shape.x]);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glBindTexture(GL_TEXTURE_2D, change_texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, shape.x, last_row - first_row + 1, GL_RG, GL_FLOAT, &changes[size_t(first_row) * shape.x]);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+    }
+
+    void draw_texture(float aspect)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, tile_texture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, change_texture);
+
+        // cover just the part of the board in view:
+        glm::vec2 area_min = glm::max(camera.view_min(aspect), glm::vec2(0.0f));
+        glm::vec2 area_max = glm::min(camera.view_max(aspect), glm::vec2(shape));
+        if (area_min.x < area_max.x && area_min.y < area_max.y) {
+            glm::vec4 tile_to_clip = camera.tile_to_clip(aspect);
+            glUseProgram(game_board_texture_program->program);
+            glUniform4f(game_board_texture_program->TILE_TO_CLIP_vec4, tile_to_clip.x, tile_to_clip.y, tile_to_clip.z, tile_to_clip.w);
+            glUniform2f(game_board_texture_program->AREA_MIN_vec2, area_min.x, area_min.y);
+            glUniform2f(game_board_texture_program->AREA_MAX_vec2, area_max.x, area_max.y);
+            glUniform1f(game_board_texture_program->MAX_OVER_float, float(Tile::max_over));
+            glUniform4f(game_board_texture_program->OVERRIDE_COLOR_vec4, override_colour.x, override_colour.y, override_colour.z, override_colour.w);
+            glUniform1f(game_board_texture_program->TIME_float, now());
+            glUniform1f(game_board_texture_program->FADE_TIME_float, FadeTime);
+            glBindVertexArray(vertex_array);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+            glUseProgram(0);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // zoomed out (any Rendering): one texture per pyramid level, uploaded only when that level is drawn
+    std::vector<GLuint> heat_textures; // heat_textures[k - 1] mirrors pyramid level k
+    GLuint heat_vertex_array = 0;
+
+    void create_heat_resources()
+    {
+        heat_textures.resize(pyramid.level_count());
+        glGenTextures(GLsizei(heat_textures.size()), heat_textures.data());
+        for (uint32_t level = 1; level <= pyramid.level_count(); level++) {
+            OccupancyPyramid::Level const& l = pyramid.at(level);
+            glBindTexture(GL_TEXTURE_2D, heat_textures[level - 1]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32I, l.width, l.height, 0, GL_RG_INTEGER, GL_INT, l.cells.data());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            uint32_t first_row, last_row;
+            pyramid.take_dirty_rows(level, &first_row, &last_row); // (just uploaded)
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenVertexArrays(1, &heat_vertex_array);
+        glBindVertexArray(heat_vertex_array);
+        glBindBuffer(GL_ARRAY_BUFFER, quad_buffer);
+        glVertexAttribPointer(game_board_heat_program->Corner_vec2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (GLbyte*)0);
+        glEnableVertexAttribArray(game_board_heat_program->Corner_vec2);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    void draw_heat(float aspect, uint32_t level)
+    {
+        OccupancyPyramid::Level const& l = pyramid.at(level);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, heat_textures[level - 1]);
+        uint32_t first_row, last_row;
+        if (pyramid.take_dirty_rows(level, &first_row, &last_row)) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, GLint(first_row), l.width, GLsizei(last_row - first_row + 1), GL_RG_INTEGER, GL_INT, &l.cells[size_t(first_row) * l.width]);
+        }
+
+        glm::vec2 area_min = glm::max(camera.view_min(aspect), glm::vec2(0.0f));
+        glm::vec2 area_max = glm::min(camera.view_max(aspect), glm::vec2(shape));
+        if (area_min.x < area_max.x && area_min.y < area_max.y) {
+            glm::vec4 tile_to_clip = camera.tile_to_clip(aspect);
+            glm::ivec2 override_cell(-1, -1);
+            if (override_tile >= 0) {
+                override_cell = glm::ivec2(int(override_tile % shape.x) >> level, int(override_tile / shape.x) >> level);
+            }
+            glUseProgram(game_board_heat_program->program);
+            glUniform4f(game_board_heat_program->TILE_TO_CLIP_vec4, tile_to_clip.x, tile_to_clip.y, tile_to_clip.z, tile_to_clip.w);
+            glUniform2f(game_board_heat_program->AREA_MIN_vec2, area_min.x, area_min.y);
+            glUniform2f(game_board_heat_program->AREA_MAX_vec2, area_max.x, area_max.y);
+            glUniform1f(game_board_heat_program->CELL_SIZE_float, float(1u << level));
+            glUniform1f(game_board_heat_program->MAX_OVER_float, float(Tile::max_over));
+            glUniform2i(game_board_heat_program->OVERRIDE_CELL_ivec2, override_cell.x, override_cell.y);
+            glUniform4f(game_board_heat_program->OVERRIDE_COLOR_vec4, override_colour.x, override_colour.y, override_colour.z, override_colour.w);
+            glBindVertexArray(heat_vertex_array);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+            glUseProgram(0);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
 };
@@ -0,0 +1,70 @@
+#include "GameBoardHeatProgram.hpp"
+
+#include "gl_compile_program.hpp"
+#include "gl_errors.hpp"
+
+Load< GameBoardHeatProgram > game_board_heat_program(LoadTagEarly);
+
+GameBoardHeatProgram::GameBoardHeatProgram() {
+	program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		"uniform vec4 TILE_TO_CLIP;\n"
+		"uniform vec2 AREA_MIN;\n"
+		"uniform vec2 AREA_MAX;\n"
+		"in vec2 Corner;\n" //(0,0) to (1,1) across the area
+		"out vec2 tileCoord;\n"
+		"void main() {\n"
+		"	tileCoord = mix(AREA_MIN, AREA_MAX, Corner);\n"
+		"	gl_Position = vec4(tileCoord * TILE_TO_CLIP.xy + TILE_TO_CLIP.zw, 0.0, 1.0);\n"
+		"}\n"
+	,
+		//fragment shader:
+		"#version 330\n"
+		"uniform isampler2D CELLS;\n"
+		"uniform float CELL_SIZE;\n"
+		"uniform float MAX_OVER;\n"
+		"uniform ivec2 OVERRIDE_CELL;\n"
+		"uniform vec4 OVERRIDE_COLOR;\n"
+		"in vec2 tileCoord;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	ivec2 size = textureSize(CELLS, 0);\n"
+		"	ivec2 cell = clamp(ivec2(floor(tileCoord / CELL_SIZE)), ivec2(0), size - 1);\n"
+		"	ivec2 state = texelFetch(CELLS, cell, 0).rg;\n"
+		"	if (state.g > 0) {\n"
+		"		fragColor = vec4(1.0, 1.0, 0.0, 1.0);\n"
+		"	} else if (cell == OVERRIDE_CELL) {\n"
+		"		fragColor = OVERRIDE_COLOR;\n"
+		"	} else {\n"
+		"		float lum = min(1.0, float(state.r) / MAX_OVER);\n"
+		"		fragColor = vec4(lum, lum, lum, 1.0);\n"
+		"	}\n"
+		"}\n"
+	);
+
+	//look up the locations of vertex attributes:
+	Corner_vec2 = glGetAttribLocation(program, "Corner");
+
+	//look up the locations of uniforms:
+	TILE_TO_CLIP_vec4 = glGetUniformLocation(program, "TILE_TO_CLIP");
+	AREA_MIN_vec2 = glGetUniformLocation(program, "AREA_MIN");
+	AREA_MAX_vec2 = glGetUniformLocation(program, "AREA_MAX");
+	CELL_SIZE_float = glGetUniformLocation(program, "CELL_SIZE");
+	MAX_OVER_float = glGetUniformLocation(program, "MAX_OVER");
+	OVERRIDE_CELL_ivec2 = glGetUniformLocation(program, "OVERRIDE_CELL");
+	OVERRIDE_COLOR_vec4 = glGetUniformLocation(program, "OVERRIDE_COLOR");
+	GLuint CELLS_isampler2D = glGetUniformLocation(program, "CELLS");
+
+	//set CELLS to always refer to texture binding zero:
+	glUseProgram(program);
+	glUniform1i(CELLS_isampler2D, 0);
+	glUseProgram(0);
+
+	GL_ERRORS();
+}
+
+GameBoardHeatProgram::~GameBoardHeatProgram() {
+	glDeleteProgram(program);
+	program = 0;
+}
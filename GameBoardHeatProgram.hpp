@@ -0,0 +1,27 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Load.hpp"
+
+//Shader program that draws (the visible part of) a GameBoard zoomed far out, as a heatmap of
+// aggregated cells from one level of an OccupancyPyramid (see GameBoard::draw_heat):
+struct GameBoardHeatProgram {
+	GameBoardHeatProgram();
+	~GameBoardHeatProgram();
+
+	GLuint program = 0;
+	//Attribute (per-vertex variable) locations:
+	GLuint Corner_vec2 = -1U;
+	//Uniform (per-invocation variable) locations:
+	GLuint TILE_TO_CLIP_vec4 = -1U; //clip = tile * TILE_TO_CLIP.xy + TILE_TO_CLIP.zw
+	GLuint AREA_MIN_vec2 = -1U; //part of the board to cover, in tiles
+	GLuint AREA_MAX_vec2 = -1U;
+	GLuint CELL_SIZE_float = -1U; //tiles across a cell
+	GLuint MAX_OVER_float = -1U;
+	GLuint OVERRIDE_CELL_ivec2 = -1U; //cell holding the tile drawn in its own colour ((-1,-1) if none)
+	GLuint OVERRIDE_COLOR_vec4 = -1U;
+	//Textures:
+	//TEXTURE0 - cells (GL_RG32I: r = explorers, g = treasures)
+};
+
+extern Load< GameBoardHeatProgram > game_board_heat_program;
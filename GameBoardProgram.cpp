@@ -0,0 +1,50 @@
+#include "GameBoardProgram.hpp"
+
+#include "gl_compile_program.hpp"
+#include "gl_errors.hpp"
+
+Load< GameBoardProgram > game_board_program(LoadTagEarly);
+
+GameBoardProgram::GameBoardProgram() {
+	program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		"uniform vec4 TILE_TO_CLIP;\n"
+		"uniform float TIME;\n"
+		"uniform float FADE_TIME;\n"
+		"in vec2 Corner;\n" //(0,0) to (1,1) across the quad
+		"in vec2 Position;\n" //this instance's tile (x, y), in tiles
+		"in vec4 Color;\n"
+		"in vec2 Change;\n" //(when the tile last changed, how much brighter it was before)
+		"out vec4 color;\n"
+		"void main() {\n"
+		"	gl_Position = vec4((Position + Corner) * TILE_TO_CLIP.xy + TILE_TO_CLIP.zw, 0.0, 1.0);\n"
+		"	float fade = 1.0 - clamp((TIME - Change.x) / FADE_TIME, 0.0, 1.0);\n"
+		"	color = vec4(Color.rgb + vec3(Change.y * fade), Color.a);\n"
+		"}\n"
+	,
+		//fragment shader:
+		"#version 330\n"
+		"in vec4 color;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	fragColor = color;\n"
+		"}\n"
+	);
+
+	//look up the locations of vertex attributes:
+	Corner_vec2 = glGetAttribLocation(program, "Corner");
+	Position_vec2 = glGetAttribLocation(program, "Position");
+	Color_vec4 = glGetAttribLocation(program, "Color");
+	Change_vec2 = glGetAttribLocation(program, "Change");
+
+	//look up the locations of uniforms:
+	TILE_TO_CLIP_vec4 = glGetUniformLocation(program, "TILE_TO_CLIP");
+	TIME_float = glGetUniformLocation(program, "TIME");
+	FADE_TIME_float = glGetUniformLocation(program, "FADE_TIME");
+}
+
+GameBoardProgram::~GameBoardProgram() {
+	glDeleteProgram(program);
+	program = 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Load.hpp"
+
+//Shader program that draws every tile of a GameBoard with one instanced draw call:
+// a unit quad (Corner) is placed once per tile instance (Position, Color)
+struct GameBoardProgram {
+	GameBoardProgram();
+	~GameBoardProgram();
+
+	GLuint program = 0;
+	//Attribute (per-vertex variable) locations:
+	GLuint Corner_vec2 = -1U;
+	//Attribute (per-instance variable) locations:
+	GLuint Position_vec2 = -1U;
+	GLuint Color_vec4 = -1U;
+	GLuint Change_vec2 = -1U; //(time of the tile's last change, brightness it had just before it)
+	//Uniform (per-invocation variable) locations:
+	GLuint TILE_TO_CLIP_vec4 = -1U; //clip = tile * TILE_TO_CLIP.xy + TILE_TO_CLIP.zw
+	GLuint TIME_float = -1U; //now, on the same clock as Change.x
+	GLuint FADE_TIME_float = -1U; //seconds a change takes to fade in
+	//Textures:
+	// none
+};
+
+extern Load< GameBoardProgram > game_board_program;
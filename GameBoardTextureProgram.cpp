@@ -0,0 +1,75 @@
+#include "GameBoardTextureProgram.hpp"
+
+#include "gl_compile_program.hpp"
+#include "gl_errors.hpp"
+
+Load< GameBoardTextureProgram > game_board_texture_program(LoadTagEarly);
+
+GameBoardTextureProgram::GameBoardTextureProgram() {
+	program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		"uniform vec4 TILE_TO_CLIP;\n"
+		"uniform vec2 AREA_MIN;\n"
+		"uniform vec2 AREA_MAX;\n"
+		"in vec2 Corner;\n" //(0,0) to (1,1) across the area
+		"out vec2 tileCoord;\n"
+		"void main() {\n"
+		"	tileCoord = mix(AREA_MIN, AREA_MAX, Corner);\n"
+		"	gl_Position = vec4(tileCoord * TILE_TO_CLIP.xy + TILE_TO_CLIP.zw, 0.0, 1.0);\n"
+		"}\n"
+	,
+		//fragment shader:
+		"#version 330\n"
+		"uniform isampler2D TILES;\n" //r = explorers on the tile, g = flags (1 = treasure, 2 = override)
+		"uniform float MAX_OVER;\n"
+		"uniform vec4 OVERRIDE_COLOR;\n"
+		"uniform sampler2D CHANGES;\n" //r = time of the tile's last change, g = explorers that left in it
+		"uniform float TIME;\n"
+		"uniform float FADE_TIME;\n"
+		"in vec2 tileCoord;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	ivec2 size = textureSize(TILES, 0);\n"
+		"	ivec2 tile = clamp(ivec2(floor(tileCoord)), ivec2(0), size - 1);\n"
+		"	ivec2 state = texelFetch(TILES, tile, 0).rg;\n"
+		"	if ((state.g & 1) != 0) {\n"
+		"		fragColor = vec4(1.0, 1.0, 0.0, 1.0);\n"
+		"	} else if ((state.g & 2) != 0) {\n"
+		"		fragColor = OVERRIDE_COLOR;\n"
+		"	} else {\n"
+		"		vec2 change = texelFetch(CHANGES, tile, 0).rg;\n"
+		"		float fade = 1.0 - clamp((TIME - change.r) / FADE_TIME, 0.0, 1.0);\n"
+		"		float lum = (float(state.r) + change.g * fade) / MAX_OVER;\n"
+		"		fragColor = vec4(lum, lum, lum, 1.0);\n"
+		"	}\n"
+		"}\n"
+	);
+
+	//look up the locations of vertex attributes:
+	Corner_vec2 = glGetAttribLocation(program, "Corner");
+
+	//look up the locations of uniforms:
+	TILE_TO_CLIP_vec4 = glGetUniformLocation(program, "TILE_TO_CLIP");
+	AREA_MIN_vec2 = glGetUniformLocation(program, "AREA_MIN");
+	AREA_MAX_vec2 = glGetUniformLocation(program, "AREA_MAX");
+	MAX_OVER_float = glGetUniformLocation(program, "MAX_OVER");
+	OVERRIDE_COLOR_vec4 = glGetUniformLocation(program, "OVERRIDE_COLOR");
+	TIME_float = glGetUniformLocation(program, "TIME");
+	FADE_TIME_float = glGetUniformLocation(program, "FADE_TIME");
+	GLuint TILES_isampler2D = glGetUniformLocation(program, "TILES");
+	GLuint CHANGES_sampler2D = glGetUniformLocation(program, "CHANGES");
+
+	//set TILES to always refer to texture binding zero, CHANGES to binding one:
+	glUseProgram(program);
+	glUniform1i(TILES_isampler2D, 0);
+	glUniform1i(CHANGES_sampler2D, 1);
+	glUseProgram(0);
+
+	GL_ERRORS();
+}
+
+GameBoardTextureProgram::~GameBoardTextureProgram() {
+	glDeleteProgram(program);
+	program = 0;
+}
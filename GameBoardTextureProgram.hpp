@@ -0,0 +1,28 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Load.hpp"
+
+//Shader program that draws (the visible part of) a GameBoard as one quad, looking each fragment's tile up
+// in an integer texture of tile states (see GameBoard::TileTexel for the texel layout):
+struct GameBoardTextureProgram {
+	GameBoardTextureProgram();
+	~GameBoardTextureProgram();
+
+	GLuint program = 0;
+	//Attribute (per-vertex variable) locations:
+	GLuint Corner_vec2 = -1U;
+	//Uniform (per-invocation variable) locations:
+	GLuint TILE_TO_CLIP_vec4 = -1U; //clip = tile * TILE_TO_CLIP.xy + TILE_TO_CLIP.zw
+	GLuint AREA_MIN_vec2 = -1U; //part of the board to cover, in tiles
+	GLuint AREA_MAX_vec2 = -1U;
+	GLuint MAX_OVER_float = -1U;
+	GLuint OVERRIDE_COLOR_vec4 = -1U;
+	GLuint TIME_float = -1U; //now, on the same clock as the change times
+	GLuint FADE_TIME_float = -1U; //seconds a change takes to fade in
+	//Textures:
+	//TEXTURE0 - tile states (GL_RG8I, one texel per tile)
+	//TEXTURE1 - tile changes (GL_RG32F: time of the last change, explorers that left in it)
+};
+
+extern Load< GameBoardTextureProgram > game_board_texture_program;
@@ -138,6 +138,9 @@ if (maek.OS === 'windows') {
 const client_names = [
 	maek.CPP('client.cpp'),
 	maek.CPP('PlayMode.cpp'),
+	maek.CPP('GameBoardProgram.cpp'),
+	maek.CPP('GameBoardTextureProgram.cpp'),
+	maek.CPP('GameBoardHeatProgram.cpp'),
 	maek.CPP('LitColorTextureProgram.cpp'),
 	//maek.CPP('ColorTextureProgram.cpp'),  //not used right now, but you might want it
 	maek.CPP('Sound.cpp'),
@@ -149,6 +152,20 @@ const server_names = [
 	maek.CPP('server.cpp')
 ];
 
+const relay_names = [
+	maek.CPP('relay.cpp')
+];
+
+const router_names = [
+	maek.CPP('router.cpp')
+];
+
+//networking code (also used by the bench-net benchmark):
+const connection_names = [
+	maek.CPP('Connection.cpp'),
+	maek.CPP('TimerWheel.cpp')
+];
+
 const common_names = [
 	maek.CPP('data_path.cpp'),
 	maek.CPP('PathFont.cpp'),
@@ -162,7 +179,11 @@ const common_names = [
 	maek.CPP('Mode.cpp'),
 	maek.CPP('GL.cpp'),
 	maek.CPP('Load.cpp'),
-	maek.CPP('Connection.cpp'),
+	...connection_names,
+	maek.CPP('Game.cpp'),
+	maek.CPP('Checkpoint.cpp'),
+	maek.CPP('BoardMirror.cpp'),
+	maek.CPP('Task.cpp'),
 	maek.CPP('hex_dump.cpp')
 ];
 
@@ -184,11 +205,15 @@ const show_scene_names = [
 //returns exeFile: exeFileBase + a platform-dependant suffix (e.g., '.exe' on windows)
 const client_exe = maek.LINK([...client_names, ...common_names], 'dist/client');
 const server_exe = maek.LINK([...server_names, ...common_names], 'dist/server');
+const relay_exe = maek.LINK([...relay_names, ...common_names], 'dist/relay');
+const router_exe = maek.LINK([...router_names, ...common_names], 'dist/router');
 const show_meshes_exe = maek.LINK([...show_meshes_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
+const board_mirror_exe = maek.LINK([maek.CPP('board-mirror.cpp'), maek.CPP('BoardMirror.cpp')], 'dist/board-mirror');
+const bench_net_exe = maek.LINK([maek.CPP('bench-net.cpp'), ...connection_names], 'dist/bench-net');
 
 //set the default target to the game (and copy the readme files):
-maek.TARGETS = [client_exe, server_exe, show_meshes_exe, show_scene_exe, ...copies];
+maek.TARGETS = [client_exe, server_exe, relay_exe, router_exe, board_mirror_exe, show_meshes_exe, show_scene_exe, ...copies];
 
 //the '[targets =] RULE(targets, prerequisites[, recipe])' rule defines a Makefile-style task
 // targets: array of targets the task produces (can include both files and ':abstract targets')
@@ -199,6 +224,11 @@ maek.RULE([':run'], [client_exe], [
 	[client_exe, '--some-command-line-option']
 ]);
 
+//'node Maekfile.js :bench-net' builds and runs the networking benchmarks:
+maek.RULE([':bench-net'], [bench_net_exe], [
+	[bench_net_exe]
+]);
+
 //Note that tasks that produce ':abstract targets' are never cached.
 // This is similar to how .PHONY targets behave in make.
 
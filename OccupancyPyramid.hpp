@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Occupancy pyramid over a width x height grid, for drawing huge boards zoomed out:
+//  level k (k >= 1) has one cell per 2^k x 2^k block of tiles, holding the explorers and treasures
+//  in that block. A tile change touches one cell per level, so keeping the pyramid current costs
+//  O(levels) per change instead of rebuilding anything. Each level also remembers the span of rows
+//  that changed since it was last taken, so whoever mirrors it (e.g., into a texture) can copy just those.
+//
+// For example:
+//
+//   OccupancyPyramid pyramid(1024, 1024);
+//   pyramid.add(x, y, +1, 0); // an explorer arrived at (x, y)
+//   pyramid.cell(3, x >> 3, y >> 3).over; // explorers in the 8x8 block around (x, y)
+struct OccupancyPyramid {
+    struct Cell {
+        int32_t over = 0; // explorers
+        int32_t treasures = 0;
+    };
+
+    struct Level {
+        uint32_t width = 0, height = 0;
+        std::vector<Cell> cells; // row-major
+        uint32_t first_dirty_row = 0, last_dirty_row = 0; // (empty span when first > last)
+        bool dirty() const { return first_dirty_row <= last_dirty_row; }
+    };
+
+    OccupancyPyramid(uint32_t width_, uint32_t height_)
+        : width(width_)
+        , height(height_)
+    {
+        // halve until a single cell covers everything:
+        uint32_t w = width, h = height;
+        while (w > 1 || h > 1) {
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+            Level level;
+            level.width = w;
+            level.height = h;
+            level.cells.resize(size_t(w) * h);
+            level.last_dirty_row = h - 1; // (everything is new)
+            levels.emplace_back(std::move(level));
+        }
+    }
+
+    // levels above the tiles themselves (level k is levels[k - 1]):
+    uint32_t level_count() const { return uint32_t(levels.size()); }
+
+    Cell const& cell(uint32_t level, uint32_t x, uint32_t y) const
+    {
+        Level const& l = at(level);
+        assert(x < l.width && y < l.height);
+        return l.cells[size_t(y) * l.width + x];
+    }
+
+    // tile (x, y) gained 'over' explorers and 'treasures' treasures (either may be negative):
+    void add(uint32_t x, uint32_t y, int32_t over, int32_t treasures)
+    {
+        assert(x < width && y < height);
+        for (Level& l : levels) {
+            x >>= 1;
+            y >>= 1;
+            Cell& c = l.cells[size_t(y) * l.width + x];
+            c.over += over;
+            c.treasures += treasures;
+            l.first_dirty_row = std::min(l.first_dirty_row, y);
+            l.last_dirty_row = std::max(l.last_dirty_row, y);
+        }
+    }
+
+    void clear()
+    {
+        for (Level& l : levels) {
+            std::fill(l.cells.begin(), l.cells.end(), Cell());
+            l.first_dirty_row = 0;
+            l.last_dirty_row = l.height - 1;
+        }
+    }
+
+    // the rows of 'level' changed since the last take (returns false if none did):
+    bool take_dirty_rows(uint32_t level, uint32_t* first_row, uint32_t* last_row)
+    {
+        Level& l = at(level);
+        if (!l.dirty())
+            return false;
+        *first_row = l.first_dirty_row;
+        *last_row = l.last_dirty_row;
+        l.first_dirty_row = l.height;
+        l.last_dirty_row = 0;
+        return true;
+    }
+
+    //-- internals --
+    uint32_t width, height;
+    std::vector<Level> levels;
+
+    Level& at(uint32_t level)
+    {
+        assert(level >= 1 && level <= levels.size());
+        return levels[level - 1];
+    }
+    Level const& at(uint32_t level) const
+    {
+        assert(level >= 1 && level <= levels.size());
+        return levels[level - 1];
+    }
+};
@@ -7,14 +7,31 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cmath>
 #include <random>
 
-PlayMode::PlayMode(Client& client_)
-    : client(client_)
+PlayMode::PlayMode(Client& client_, bool spectating_)
+    : spectating(spectating_)
+    , client(client_)
 {
     srand(time(0));
     board = new GameBoard(board_size);
     pos = PlayMode::random_pos();
+    if (!spectating)
+        board->camera.center = glm::vec2(pos) + glm::vec2(0.5f);
+
+    if (spectating) {
+        // say hello as a spectator (repeated as the keepalive in update()):
+        client.connection.send(Message::C2S_Spectate);
+        return;
+    }
+
+    // tell the server where we start out:
+    InputRecord input;
+    input.seq = next_input_seq++;
+    input.pos_x = static_cast<uint8_t>(pos.x);
+    input.pos_y = static_cast<uint8_t>(pos.y);
+    pending_inputs.emplace_back(input);
 }
 
 PlayMode::~PlayMode()
@@ -23,6 +40,20 @@ PlayMode::~PlayMode()
 
 bool PlayMode::handle_event(SDL_Event const& evt, glm::uvec2 const& window_size)
 {
+    // camera controls (for players and spectators alike):
+    if (evt.type == SDL_MOUSEWHEEL) {
+        board->camera.zoom(std::pow(CameraZoomStep, float(evt.wheel.y)));
+        return true;
+    } else if (evt.type == SDL_MOUSEMOTION && (evt.motion.state & SDL_BUTTON_LMASK)) {
+        // drag the board around (until the player next moves):
+        float tiles_per_pixel = board->camera.view_height / float(window_size.y);
+        board->camera.center -= glm::vec2(float(evt.motion.xrel), float(evt.motion.yrel)) * tiles_per_pixel;
+        camera_follows = false;
+        return true;
+    }
+
+    if (spectating)
+        return false;
 
     if (evt.type == SDL_KEYDOWN) {
         if (evt.key.repeat) {
@@ -31,21 +62,25 @@ bool PlayMode::handle_event(SDL_Event const& evt, glm::uvec2 const& window_size)
             left.downs += 1;
             left.pressed = true;
             pos.x = std::max(0, pos.x - 1);
+            camera_follows = true;
             return true;
         } else if (evt.key.keysym.sym == SDLK_RIGHT) {
             right.downs += 1;
             right.pressed = true;
             pos.x = std::min(board->shape.x - 1, pos.x + 1);
+            camera_follows = true;
             return true;
         } else if (evt.key.keysym.sym == SDLK_UP) {
             up.downs += 1;
             up.pressed = true;
             pos.y = std::max(0, pos.y - 1);
+            camera_follows = true;
             return true;
         } else if (evt.key.keysym.sym == SDLK_DOWN) {
             down.downs += 1;
             down.pressed = true;
             pos.y = std::min(board->shape.y - 1, pos.y + 1);
+            camera_follows = true;
             return true;
         } else if (evt.key.keysym.sym == SDLK_RETURN || evt.key.keysym.sym == SDLK_SPACE) {
             enter.downs += 1;
@@ -77,13 +112,47 @@ bool PlayMode::handle_event(SDL_Event const& evt, glm::uvec2 const& window_size)
 void PlayMode::update(float elapsed)
 {
 
-    // queue data for sending to server:
+    // record this frame's input:
     if (left.downs || right.downs || down.downs || up.downs || enter.downs) {
-        // send a five-byte message of type 'b':
-        client.connections.back().send('b');
-        client.connections.back().send(static_cast<unsigned char>(pos.x));
-        client.connections.back().send(static_cast<unsigned char>(pos.y));
-        client.connections.back().send(enter.pressed);
+        InputRecord input;
+        input.seq = next_input_seq++;
+        input.pos_x = static_cast<uint8_t>(pos.x);
+        input.pos_y = static_cast<uint8_t>(pos.y);
+        input.enter = (enter.pressed || enter.downs) ? 1 : 0;
+        input.seen_tick = server_tick;
+        pending_inputs.emplace_back(input);
+    }
+
+    // queue data for sending to server, one batch per send interval:
+    input_send_timer += elapsed;
+    input_keepalive_timer += elapsed;
+    if (spectating && input_keepalive_timer >= input_keepalive_interval) {
+        input_keepalive_timer = 0.0f;
+        client.connection.send(Message::C2S_Spectate);
+    }
+    if (pending_inputs.empty() && input_keepalive_timer >= input_keepalive_interval && !sent_inputs.empty()) {
+        // nothing new to say; repeat the last batch (the server ignores inputs it has already applied):
+        input_keepalive_timer = 0.0f;
+        uint32_t timestamp_ms = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count());
+        send_input_batch(&client.connection, timestamp_ms, sent_inputs);
+    }
+    if (!pending_inputs.empty() && input_send_timer >= input_send_interval) {
+        input_send_timer = 0.0f;
+        input_keepalive_timer = 0.0f;
+        uint32_t timestamp_ms = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count());
+        while (!pending_inputs.empty()) {
+            // lead with the last few inputs that were already sent, then everything new:
+            std::deque<InputRecord> batch(sent_inputs.begin(), sent_inputs.end());
+            while (!pending_inputs.empty() && batch.size() < MaxInputBatch) {
+                batch.emplace_back(pending_inputs.front());
+                sent_inputs.emplace_back(pending_inputs.front());
+                pending_inputs.pop_front();
+            }
+            send_input_batch(&client.connection, timestamp_ms, batch);
+            while (sent_inputs.size() > InputRedundancy) {
+                sent_inputs.pop_front();
+            }
+        }
     }
 
     // reset button press counters:
@@ -105,57 +174,99 @@ void PlayMode::update(float elapsed)
             std::cout << "[" << c->socket << "] recv'd data. Current buffer:\n"
                       << hex_dump(c->recv_buffer);
             std::cout.flush();
-            // expecting message(s) like 'm' + 3-byte length + length bytes of text:
-            while (c->recv_buffer.size() >= 4) {
-                std::cout << "[" << c->socket << "] recv'd data. Current buffer:\n"
-                          << hex_dump(c->recv_buffer);
-                std::cout.flush();
-                char type = c->recv_buffer[0];
-                if (type != 'm') {
-                    throw std::runtime_error("Server sent unknown message type '" + std::to_string(type) + "'");
+            // expecting board messages ('m' + 3-byte length + tick + board) or, in lockstep mode, a snapshot and then bundles:
+            // (each recv_* consumes one message from the buffer; for boards, keep the newest)
+            while (!c->recv_buffer.empty()) {
+                Message type = Message(c->recv_buffer[0]);
+                if (type == Message::S2C_Board) {
+                    if (!recv_board(c, &server_tick, &server_message))
+                        break;
+                    board_changed = true;
+                } else if (type == Message::S2C_Ping) {
+                    // answer right away, so the server's round-trip measurement doesn't include our frame time:
+                    uint32_t id;
+                    if (!recv_ping(c, Message::S2C_Ping, &id))
+                        break;
+                    send_ping(c, Message::C2S_Pong, id);
+                } else if (type == Message::S2C_LockstepStart) {
+                    if (!recv_lockstep_start(c, &lockstep_player, &lockstep_state))
+                        break;
+                    lockstep = true;
+                    lockstep_synced = true;
+                    server_tick = lockstep_state.tick;
+                    server_message = lockstep_state.encode_board();
+                    board_changed = true;
+                } else if (type == Message::S2C_TickBundle) {
+                    uint32_t tick;
+                    bool has_hash;
+                    uint64_t hash;
+                    lockstep_events.clear();
+                    if (!recv_tick_bundle(c, &tick, &lockstep_events, &has_hash, &hash))
+                        break;
+                    if (!lockstep_synced || tick <= lockstep_state.tick)
+                        continue; // (waiting on a resync, or from before the snapshot)
+                    // bundles come every tick, but catch up on any that were empty just in case:
+                    while (lockstep_state.tick + 1 < tick) {
+                        lockstep_state.step();
+                    }
+                    for (auto const& event : lockstep_events) {
+                        lockstep_state.apply(event);
+                    }
+                    lockstep_state.step();
+                    if (has_hash && hash != lockstep_state.hash()) {
+                        std::cout << "Out of sync with the server at tick " << tick << "; asking for a resync." << std::endl;
+                        lockstep_synced = false;
+                        c->send(Message::C2S_Resync);
+                    }
+                    server_tick = lockstep_state.tick;
+                    server_message = lockstep_state.encode_board();
+                    board_changed = true;
+                } else {
+                    throw std::runtime_error("Unexpected message type '" + std::string(1, char(type)) + "' from server.");
                 }
-                uint32_t size = ((uint32_t(c->recv_buffer[1]) << 16) | (uint32_t(c->recv_buffer[2]) << 8) | (uint32_t(c->recv_buffer[3])));
-                if (c->recv_buffer.size() < 4 + size)
-                    break; // if whole message isn't here, can't process
-                // whole message *is* here, so set current server message:
-                server_message = std::string(c->recv_buffer.begin() + 4, c->recv_buffer.begin() + 4 + size);
-
-                // and consume this part of the buffer:
-                c->recv_buffer.erase(c->recv_buffer.begin(), c->recv_buffer.begin() + 4 + size);
             }
         }
     },
         0.0);
 
-    // update board state
-    {
-        for (int i = 0; i < server_message.size(); i++) {
-            int new_num_over = static_cast<int>(std::fabs(server_message[i]));
-            board->board[i].delta = board->board[i].num_over - new_num_over;
-            board->board[i].num_over = new_num_over;
-            // treasure located if server message < 0
-            board->board[i].treasure = (server_message[i] < 0);
-            // colour treasure yellow
-            board->board[i].colour_other = true; // colour with this colour
-        }
+    // update board state (only the tiles that changed get touched):
+    if (board_changed) {
+        board->apply(server_message);
+        board_changed = false;
         Tile::max_over = 1;
     }
 
-    {
+    if (spectating)
+        return;
+
+    if (lockstep) {
+        // the simulation keeps score:
+        auto f = lockstep_state.players.find(lockstep_player);
+        if (f != lockstep_state.players.end())
+            score = f->second.total;
+    } else {
         if (board->GetTile(pos).treasure && enter.pressed && last_found != pos) {
             score += 1;
             last_found = pos;
         }
     }
 
+    // keep the camera on the player:
+    if (camera_follows) {
+        glm::vec2 target = glm::vec2(pos) + glm::vec2(0.5f);
+        board->camera.center += (target - board->camera.center) * std::min(1.0f, CameraFollowRate * elapsed);
+    }
+
     // colour this tile blue
-    {
+    auto& this_tile = board->GetTile(pos);
+    if (&this_tile != last_tile) {
         if (last_tile != nullptr) {
             last_tile->colour_other = true;
+            board->mark_dirty(*last_tile);
         }
-        auto& this_tile = board->GetTile(pos);
         this_tile.colour_other = false; // colour with this colour
         this_tile.colour = glm::vec4(0.f, 0.f, 1.f, 1.f);
+        board->mark_dirty(this_tile);
         last_tile = &this_tile;
     }
 }
@@ -188,7 +299,7 @@ void PlayMode::draw(glm::uvec2 const& drawable_size)
 
         // draw_text(glm::vec2(-aspect + 0.1f, 0.0f), server_message, 0.09f);
 
-        draw_text(glm::vec2(-aspect + 0.1f, -0.9f), "(Your score: " + std::to_string(score) + ")", 0.09f);
+        draw_text(glm::vec2(-aspect + 0.1f, -0.9f), spectating ? "(Spectating)" : "(Your score: " + std::to_string(score) + ")", 0.09f);
     }
 
     // draw game board
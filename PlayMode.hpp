@@ -1,19 +1,19 @@
 #include "Mode.hpp"
 
 #include "Connection.hpp"
+#include "Game.hpp"
 #include "GameBoard.hpp"
 
 #include <glm/glm.hpp>
 
+#include <chrono>
 #include <deque>
 #include <time.h>
 #include <vector>
 
-#define BOARD_WIDTH 10
-#define BOARD_HEIGHT 10
-
 struct PlayMode : Mode {
-    PlayMode(Client& client);
+    // a spectating PlayMode only watches the board (e.g., through a relay) and never sends inputs:
+    PlayMode(Client& client, bool spectating = false);
     virtual ~PlayMode();
 
     // functions called by main loop:
@@ -31,11 +31,38 @@ struct PlayMode : Mode {
         uint8_t pressed = 0;
     } left, right, down, up, enter;
 
-    // last message from server:
+    // inputs not yet sent to the server, and the last few that were (repeated in the next batch):
+    std::deque<InputRecord> pending_inputs, sent_inputs;
+    uint32_t next_input_seq = 1;
+    // pending inputs are sent as one batch at most this often (0 = every frame that has input):
+    float input_send_interval = 0.0f;
+    float input_send_timer = 0.0f;
+    // when idle, the last batch is re-sent this often so the server knows the client is still there:
+    float input_keepalive_interval = 2.0f;
+    float input_keepalive_timer = 0.0f;
+    // input batches are timestamped relative to this:
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    bool spectating = false;
+
+    // last message from server, and the server tick it was sent on:
     std::string server_message;
+    bool board_changed = false; // server_message is newer than what the board shows
+    uint32_t server_tick = 0;
+
+    // lockstep mode (the server sent 'L' rather than a board): the client runs the game itself from the server's events:
+    bool lockstep = false;
+    bool lockstep_synced = false; // (false while waiting on a resync)
+    GameState lockstep_state;
+    uint32_t lockstep_player = 0; // our id in lockstep_state (0 = spectating)
+    std::vector<LockstepEvent> lockstep_events; // (reused between bundles)
 
     struct GameBoard* board;
     struct Tile* last_tile = nullptr;
+    // the camera eases toward the player unless the board has been dragged since the player last moved:
+    bool camera_follows = true;
+    static constexpr float CameraFollowRate = 8.0f; // (fraction of the way per second, roughly)
+    static constexpr float CameraZoomStep = 0.9f; // view height scale per mouse wheel notch (in)
     int score = 0;
 
     // position on the game board
@@ -5,8 +5,20 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <fstream>
 
+//frustum culling tests four boxes at once; with SSE when it is available:
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SCENE_CULL_SSE 1
+#include <xmmintrin.h>
+#else
+#define SCENE_CULL_SSE 0
+#endif
+
 //-------------------------
 
 glm::mat4x3 Scene::Transform::make_local_to_parent() const {
@@ -73,6 +85,95 @@ glm::mat4x3 Scene::Transform::make_world_to_local() const {
 
 //-------------------------
 
+void Scene::update_transforms() const {
+	//pass numbers are shared by all scenes, so a stamp from one scene's pass never looks current to another's:
+	static uint64_t last_pass = 0;
+	uint64_t pass = ++last_pass;
+	transforms_pass = pass;
+
+	for (auto const &t : transforms) {
+		Transform const *parent = t.parent;
+		//a parent not visited earlier in this pass is out of order (or not in this scene), so can't be relied on:
+		bool parent_current = (parent == nullptr || parent->updated_in == pass);
+
+		bool changed = t.world_version == 0
+			|| t.position != t.cached_position
+			|| t.rotation != t.cached_rotation
+			|| t.scale != t.cached_scale
+			|| parent != t.cached_parent
+			|| (parent && (!parent_current || parent->world_version != t.cached_parent_version));
+
+		if (changed) {
+			t.cached_position = t.position;
+			t.cached_rotation = t.rotation;
+			t.cached_scale = t.scale;
+			t.cached_parent = parent;
+			if (parent == nullptr) {
+				t.local_to_world = t.make_local_to_parent();
+			} else if (parent_current) {
+				t.local_to_world = parent->local_to_world * glm::mat4(t.make_local_to_parent());
+			} else {
+				t.local_to_world = t.make_local_to_world();
+			}
+			t.cached_parent_version = (parent ? parent->world_version : 0);
+			t.normal_to_world = glm::inverse(glm::transpose(glm::mat3(t.local_to_world)));
+			t.world_version += 1;
+			if (t.world_version == 0) t.world_version = 1; //(0 is reserved for "never computed")
+		}
+		t.updated_in = pass;
+	}
+}
+
+//-------------------------
+
+//mark the boxes that are entirely on the negative side of any of the planes:
+// (planes are (n, d) with n.x + d >= 0 inside; a box with center c and half-extents e is
+//  outside a plane when n.c + d + |n|.e < 0, i.e., even its most-inside corner is outside)
+static void cull(glm::vec4 const (&planes)[6], Scene::CullBoxes &boxes) {
+	size_t padded = boxes.cx.size();
+	assert(padded % 4 == 0);
+	boxes.outside.resize(padded);
+#if SCENE_CULL_SSE
+	__m128 zero = _mm_setzero_ps();
+	for (size_t i = 0; i < padded; i += 4) {
+		__m128 cx = _mm_loadu_ps(&boxes.cx[i]);
+		__m128 cy = _mm_loadu_ps(&boxes.cy[i]);
+		__m128 cz = _mm_loadu_ps(&boxes.cz[i]);
+		__m128 ex = _mm_loadu_ps(&boxes.ex[i]);
+		__m128 ey = _mm_loadu_ps(&boxes.ey[i]);
+		__m128 ez = _mm_loadu_ps(&boxes.ez[i]);
+		__m128 outside = zero;
+		for (glm::vec4 const &plane : planes) {
+			__m128 center = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w))
+			);
+			__m128 reach = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+				_mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez)
+			);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(center, reach), zero));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for (size_t k = 0; k < 4; ++k) {
+			boxes.outside[i + k] = uint8_t((mask >> k) & 1);
+		}
+	}
+#else
+	for (size_t i = 0; i < padded; ++i) {
+		bool outside = false;
+		for (glm::vec4 const &plane : planes) {
+			float center = plane.x * boxes.cx[i] + plane.y * boxes.cy[i] + plane.z * boxes.cz[i] + plane.w;
+			float reach = std::abs(plane.x) * boxes.ex[i] + std::abs(plane.y) * boxes.ey[i] + std::abs(plane.z) * boxes.ez[i];
+			outside = outside || (center + reach < 0.0f);
+		}
+		boxes.outside[i] = uint8_t(outside);
+	}
+#endif
+}
+
+//-------------------------
+
 glm::mat4 Scene::Camera::make_projection() const {
 	return glm::infinitePerspective( fovy, aspect, near );
 }
@@ -89,7 +190,41 @@ void Scene::draw(Camera const &camera) const {
 
 void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
 
-	//Iterate through all drawables, sending each one to OpenGL:
+	//make sure cached transforms are current:
+	update_transforms();
+
+	//normals go to light space by the inverse transpose of (world_to_light * object_to_world),
+	// which is the product of the two inverse transposes, so only one of them is computed per draw:
+	glm::mat3 normal_world_to_light = glm::inverse(glm::transpose(glm::mat3(world_to_light)));
+
+	draw_stats = DrawStats();
+
+	//view frustum planes, straight from the rows of world_to_clip (inside is -w <= x,y,z <= w):
+	// (with the usual infinite perspective, the far plane comes out as never culling anything)
+	glm::vec4 rows[4];
+	for (uint32_t r = 0; r < 4; ++r) {
+		rows[r] = glm::vec4(world_to_clip[0][r], world_to_clip[1][r], world_to_clip[2][r], world_to_clip[3][r]);
+	}
+	glm::vec4 const planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2],
+	};
+
+	CullBoxes &boxes = cull_boxes;
+	boxes.cx.clear(); boxes.cy.clear(); boxes.cz.clear();
+	boxes.ex.clear(); boxes.ey.clear(); boxes.ez.clear();
+	//boxes that can't be culled (unknown bounds, padding) are centered at the origin and infinitely big:
+	auto add_unbounded_box = [&boxes]() {
+		float inf = std::numeric_limits< float >::infinity();
+		boxes.cx.emplace_back(0.0f); boxes.cy.emplace_back(0.0f); boxes.cz.emplace_back(0.0f);
+		boxes.ex.emplace_back(inf); boxes.ey.emplace_back(inf); boxes.ez.emplace_back(inf);
+	};
+
+	//Build the render queue:
+	// each drawable gets a sort key, so that drawables sharing a program (then vertex array, then
+	// textures) end up next to each other; within those, nearer objects go first.
+	render_queue.clear();
 	for (auto const &drawable : drawables) {
 		//Reference to drawable's pipeline for convenience:
 		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
@@ -101,18 +236,87 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 		//skip any drawables that don't contain any vertices:
 		if (pipeline.count == 0) continue;
 
+		assert(drawable.transform); //drawables *must* have a transform
+		Transform const &transform = *drawable.transform;
+
+		RenderQueueEntry entry;
+		entry.drawable = &drawable;
+		entry.cached = (transform.updated_in == transforms_pass); //(false for transforms from outside this scene)
+		entry.object_to_world = (entry.cached ? transform.local_to_world : transform.make_local_to_world());
+
+		//depth of the object's origin (clip w); for w >= 0, the top bits of a float sort like the float:
+		float w = glm::dot(glm::vec4(world_to_clip[0][3], world_to_clip[1][3], world_to_clip[2][3], world_to_clip[3][3]), glm::vec4(entry.object_to_world[3], 1.0f));
+		uint32_t depth_bits = 0;
+		if (w > 0.0f) std::memcpy(&depth_bits, &w, sizeof(depth_bits));
+
+		//(only the low bits of each name go in the key; names that collide just sort together, and
+		// submission below still compares the real state)
+		entry.key = (uint64_t(pipeline.program & 0xffff) << 48)
+		          | (uint64_t(pipeline.vao & 0xffff) << 32)
+		          | (uint64_t(pipeline.textures[0].texture & 0xffff) << 16)
+		          | uint64_t(depth_bits >> 16);
+		entry.order = uint32_t(render_queue.size());
+		render_queue.emplace_back(entry);
+
+		//world-space box around the object-space box, for culling:
+		if (drawable.min.x <= drawable.max.x && drawable.min.y <= drawable.max.y && drawable.min.z <= drawable.max.z) {
+			glm::mat4x3 const &m = entry.object_to_world;
+			glm::vec3 center = m * glm::vec4(0.5f * (drawable.min + drawable.max), 1.0f);
+			glm::vec3 half = 0.5f * (drawable.max - drawable.min);
+			glm::vec3 extent = glm::abs(m[0]) * half.x + glm::abs(m[1]) * half.y + glm::abs(m[2]) * half.z;
+			boxes.cx.emplace_back(center.x); boxes.cy.emplace_back(center.y); boxes.cz.emplace_back(center.z);
+			boxes.ex.emplace_back(extent.x); boxes.ey.emplace_back(extent.y); boxes.ez.emplace_back(extent.z);
+		} else {
+			add_unbounded_box();
+		}
+	}
+
+	//Cull everything outside the view:
+	while (boxes.cx.size() % 4 != 0) add_unbounded_box();
+	cull(planes, boxes);
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < render_queue.size(); ++i) {
+			if (boxes.outside[i]) continue;
+			render_queue[kept++] = render_queue[i];
+		}
+		draw_stats.culled = uint32_t(render_queue.size() - kept);
+		render_queue.resize(kept);
+	}
+
+	std::sort(render_queue.begin(), render_queue.end(), [](RenderQueueEntry const &a, RenderQueueEntry const &b) {
+		if (a.key != b.key) return a.key < b.key;
+		return a.order < b.order;
+	});
+
+	//Submit the queue, only changing state that differs from what is already bound:
+	GLuint bound_program = 0;
+	GLuint bound_vao = 0;
+	Drawable::Pipeline::TextureInfo bound_textures[Drawable::Pipeline::TextureCount];
+	GLenum active_unit = GL_TEXTURE0;
+
+	for (auto const &entry : render_queue) {
+		Scene::Drawable const &drawable = *entry.drawable;
+		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
 
 		//Set shader program:
-		glUseProgram(pipeline.program);
+		if (pipeline.program != bound_program) {
+			glUseProgram(pipeline.program);
+			bound_program = pipeline.program;
+			draw_stats.programs += 1;
+		}
 
 		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+		if (pipeline.vao != bound_vao) {
+			glBindVertexArray(pipeline.vao);
+			bound_vao = pipeline.vao;
+			draw_stats.vaos += 1;
+		}
 
 		//Configure program uniforms:
 
 		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+		glm::mat4x3 const &object_to_world = entry.object_to_world;
 
 		//OBJECT_TO_CLIP takes vertices from object space to clip space:
 		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
@@ -130,7 +334,8 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 
 		//NORMAL_TO_CLIP takes normals from object space to light space:
 		if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
-			glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
+			glm::mat3 normal_to_world = (entry.cached ? drawable.transform->normal_to_world : glm::inverse(glm::transpose(glm::mat3(object_to_world))));
+			glm::mat3 normal_to_light = normal_world_to_light * normal_to_world;
 			glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
 		}
 
@@ -138,26 +343,38 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 		if (pipeline.set_uniforms) pipeline.set_uniforms();
 
 		//set up textures:
+		// (units a drawable leaves at 0 are left with nothing bound, as if each drawable started fresh)
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+			Drawable::Pipeline::TextureInfo const &want = pipeline.textures[i];
+			Drawable::Pipeline::TextureInfo &bound = bound_textures[i];
+			if (want.texture == bound.texture && (want.texture == 0 || want.target == bound.target)) continue;
+			if (active_unit != GL_TEXTURE0 + i) {
+				active_unit = GL_TEXTURE0 + i;
+				glActiveTexture(active_unit);
 			}
+			if (want.texture == 0) {
+				glBindTexture(bound.target, 0);
+			} else {
+				if (bound.texture != 0 && bound.target != want.target) glBindTexture(bound.target, 0);
+				glBindTexture(want.target, want.texture);
+			}
+			bound = want;
+			draw_stats.textures += 1;
 		}
 
 		//draw the object:
 		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+		draw_stats.drawn += 1;
+	}
 
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
-			}
+	//un-bind textures:
+	for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+		if (bound_textures[i].texture != 0) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(bound_textures[i].target, 0);
 		}
-		glActiveTexture(GL_TEXTURE0);
-
 	}
+	glActiveTexture(GL_TEXTURE0);
 
 	glUseProgram(0);
 	glBindVertexArray(0);
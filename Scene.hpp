@@ -15,6 +15,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <limits>
 #include <list>
 #include <memory>
 #include <functional>
@@ -43,6 +44,20 @@ struct Scene {
 		glm::mat4x3 make_local_to_world() const;
 		glm::mat4x3 make_world_to_local() const;
 
+		//Cached copies of the world matrices, kept current by Scene::update_transforms():
+		// (valid for transforms in a scene's 'transforms' list, as of that scene's last update or draw)
+		mutable glm::mat4x3 local_to_world = glm::mat4x3(1.0f);
+		mutable glm::mat3 normal_to_world = glm::mat3(1.0f); //inverse transpose of local_to_world's upper 3x3
+
+		//-- internals (used by Scene::update_transforms() to tell what changed) --
+		mutable glm::vec3 cached_position = glm::vec3(0.0f);
+		mutable glm::quat cached_rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		mutable glm::vec3 cached_scale = glm::vec3(1.0f);
+		mutable Transform const *cached_parent = nullptr;
+		mutable uint32_t cached_parent_version = 0; //parent's world_version when local_to_world was computed
+		mutable uint32_t world_version = 0; //bumped whenever local_to_world is recomputed (0 = never computed)
+		mutable uint64_t updated_in = 0; //update pass that last visited this transform
+
 		//since hierarchy is tracked through pointers, copy-constructing a transform  is not advised:
 		Transform(Transform const &) = delete;
 		//if we delete some constructors, we need to let the compiler know that the default constructor is still okay:
@@ -54,6 +69,11 @@ struct Scene {
 		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
 		Transform * transform;
 
+		//object-space bounding box (e.g., a Mesh's min and max), used to skip drawables outside the view:
+		// (the default, min > max, means "unknown"; such drawables are never culled)
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+
 		//Contains all the data needed to run the OpenGL pipeline:
 		struct Pipeline {
 			GLuint program = 0; //shader program; passed to glUseProgram
@@ -122,12 +142,52 @@ struct Scene {
 	std::list< Camera > cameras;
 	std::list< Light > lights;
 
+	//Bring every transform's cached local_to_world / normal_to_world up to date:
+	// - this is one flat pass over 'transforms'; a transform is only recomputed if its position,
+	//   rotation, scale, or parent changed since the last pass, or if its parent was recomputed
+	//   (so changes propagate down to children, and unchanged subtrees cost a few comparisons)
+	// - parents should come before their children in 'transforms' (as they do in loaded scenes);
+	//   a child that comes first is still correct, but is recomputed every pass
+	// (called by draw(); call it yourself if you want the cached matrices between draws)
+	void update_transforms() const;
+	mutable uint64_t transforms_pass = 0; //pass number of the last update_transforms() (compare with Transform::updated_in)
+
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
 	void draw(Camera const &camera) const;
 
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
 	void draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f)) const;
 
+	//draw() first culls drawables whose bounding boxes are entirely outside the view frustum
+	// (four boxes at a time, with SSE where available). It then sends the rest in order of
+	// (program, vertex array, first texture, depth) rather than the order of 'drawables', and skips
+	// binding state that is already bound, so the number of state changes tracks the number of
+	// distinct materials rather than the number of drawables.
+	//What the last draw() did (e.g., for a viewer to report):
+	struct DrawStats {
+		uint32_t drawn = 0; //drawables sent to OpenGL
+		uint32_t culled = 0; //drawables skipped for being outside the view
+		uint32_t programs = 0; //glUseProgram calls
+		uint32_t vaos = 0; //glBindVertexArray calls
+		uint32_t textures = 0; //texture binding changes
+	};
+	mutable DrawStats draw_stats;
+
+	//-- internals used by draw() --
+	struct RenderQueueEntry {
+		uint64_t key = 0; //program | vao | texture 0 | depth (16 bits each)
+		uint32_t order = 0; //position in 'drawables' (breaks ties, so the order is stable)
+		bool cached = false; //object_to_world came from the transform's cache
+		Drawable const *drawable = nullptr;
+		glm::mat4x3 object_to_world;
+	};
+	mutable std::vector< RenderQueueEntry > render_queue; //(reused between draws)
+	struct CullBoxes { //world-space boxes of render_queue entries, as centers and half-extents (padded to a multiple of 4)
+		std::vector< float > cx, cy, cz, ex, ey, ez;
+		std::vector< uint8_t > outside;
+	};
+	mutable CullBoxes cull_boxes; //(reused between draws)
+
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
 	// throws on file format errors
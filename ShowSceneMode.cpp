@@ -2,6 +2,7 @@
 #include "DrawLines.hpp"
 
 #include <iostream>
+#include <string>
 
 ShowSceneMode::ShowSceneMode(Scene const &scene_) : scene(scene_) {
 
@@ -136,4 +137,26 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 		*/
 	}
 
+	{ //report how much of the scene was culled:
+		float aspect = scene_camera->aspect;
+		DrawLines draw_lines(glm::mat4(
+			1.0f / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		));
+		glDisable(GL_DEPTH_TEST);
+
+		Scene::DrawStats const &stats = scene.draw_stats;
+		uint32_t total = stats.drawn + stats.culled;
+		uint32_t percent = (total ? (100 * stats.culled + total / 2) / total : 0);
+		float H = 0.06f;
+		draw_lines.draw_text("drawn " + std::to_string(stats.drawn) + ", culled " + std::to_string(stats.culled) + " (" + std::to_string(percent) + "%)",
+			glm::vec3(-aspect + 0.05f, -0.95f, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f),
+			glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff)
+		);
+	}
+
 }
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Sparse 2D grid for big, mostly-empty worlds:
+//  cells live in fixed-size square chunks that are only allocated while they hold a non-default value,
+//  so memory tracks the number of occupied cells rather than the area of the world.
+//  - chunks come from a pool (released chunks are reused) and are found through a hash of their coordinates
+//  - non-empty chunks are also kept in a dense list, so iterating over everything occupied never visits empty space
+//
+// For example:
+//
+//   SparseGrid<int32_t> occupancy;
+//   occupancy.add(10000, -42, 1);
+//   occupancy.for_each([](int32_t x, int32_t y, int32_t count) { ... }); // visits just (10000, -42)
+//   occupancy.add(10000, -42, -1); // the chunk holding (10000, -42) goes back to the pool
+template <typename T, uint32_t ChunkBits = 3>
+struct SparseGrid {
+    static constexpr int32_t ChunkSize = 1 << ChunkBits; // chunks are ChunkSize x ChunkSize cells
+    static constexpr uint32_t ChunkCells = ChunkSize * ChunkSize;
+
+    struct Chunk {
+        int32_t chunk_x = 0, chunk_y = 0; // position in chunks (cell position >> ChunkBits)
+        uint32_t occupied = 0; // cells holding something other than T()
+        uint32_t active_index = 0; // position in 'active'
+        T cells[ChunkCells]; // row-major
+    };
+
+    // value at (x, y); T() anywhere nothing has been set:
+    T get(int32_t x, int32_t y) const
+    {
+        auto f = index.find(key(x >> ChunkBits, y >> ChunkBits));
+        if (f == index.end())
+            return T();
+        return pool[f->second].cells[cell(x, y)];
+    }
+
+    // set (x, y) to 'value' (setting T() may release the chunk):
+    void set(int32_t x, int32_t y, T const& value)
+    {
+        bool empty_value = (value == T());
+        uint32_t c;
+        if (empty_value) {
+            auto f = index.find(key(x >> ChunkBits, y >> ChunkBits));
+            if (f == index.end())
+                return; // already empty
+            c = f->second;
+        } else {
+            c = acquire(x >> ChunkBits, y >> ChunkBits);
+        }
+        Chunk& chunk = pool[c];
+        T& at = chunk.cells[cell(x, y)];
+        bool was_empty = (at == T());
+        at = value;
+        if (was_empty && !empty_value) {
+            chunk.occupied += 1;
+        } else if (!was_empty && empty_value) {
+            assert(chunk.occupied > 0);
+            chunk.occupied -= 1;
+            if (chunk.occupied == 0)
+                release(c);
+        }
+    }
+
+    // add 'delta' to the value at (x, y) (handy for counts):
+    void add(int32_t x, int32_t y, T const& delta)
+    {
+        set(x, y, get(x, y) + delta);
+    }
+
+    // call f(x, y, value) for every cell holding something other than T():
+    // (don't change the grid from inside f)
+    template <typename F>
+    void for_each(F const& f) const
+    {
+        for (uint32_t c : active) {
+            Chunk const& chunk = pool[c];
+            for (uint32_t i = 0; i < ChunkCells; i++) {
+                if (chunk.cells[i] == T())
+                    continue;
+                f(chunk.chunk_x * ChunkSize + int32_t(i % ChunkSize), chunk.chunk_y * ChunkSize + int32_t(i / ChunkSize), chunk.cells[i]);
+            }
+        }
+    }
+
+    // call f(chunk) for every non-empty chunk:
+    template <typename F>
+    void for_each_chunk(F const& f) const
+    {
+        for (uint32_t c : active) {
+            f(pool[c]);
+        }
+    }
+
+    // number of chunks currently allocated (pool.size() is the most there have ever been at once):
+    size_t chunk_count() const { return active.size(); }
+
+    void clear()
+    {
+        pool.clear();
+        free_chunks.clear();
+        active.clear();
+        index.clear();
+    }
+
+    //-- internals --
+    std::vector<Chunk> pool;
+    std::vector<uint32_t> free_chunks; // released chunks in 'pool', ready for reuse
+    std::vector<uint32_t> active; // non-empty chunks in 'pool'
+    std::unordered_map<uint64_t, uint32_t> index; // chunk coordinates -> chunk in 'pool'
+
+    static uint64_t key(int32_t chunk_x, int32_t chunk_y)
+    {
+        return (uint64_t(uint32_t(chunk_x)) << 32) | uint64_t(uint32_t(chunk_y));
+    }
+    static uint32_t cell(int32_t x, int32_t y)
+    {
+        return uint32_t(y & (ChunkSize - 1)) * ChunkSize + uint32_t(x & (ChunkSize - 1));
+    }
+
+    // find the chunk at (chunk_x, chunk_y), allocating an empty one if there isn't one yet:
+    uint32_t acquire(int32_t chunk_x, int32_t chunk_y)
+    {
+        auto inserted = index.emplace(key(chunk_x, chunk_y), 0);
+        if (!inserted.second)
+            return inserted.first->second;
+
+        uint32_t c;
+        if (!free_chunks.empty()) {
+            c = free_chunks.back();
+            free_chunks.pop_back();
+        } else {
+            c = uint32_t(pool.size());
+            pool.emplace_back();
+        }
+        Chunk& chunk = pool[c];
+        chunk.chunk_x = chunk_x;
+        chunk.chunk_y = chunk_y;
+        chunk.occupied = 0;
+        chunk.active_index = uint32_t(active.size());
+        for (auto& v : chunk.cells) {
+            v = T();
+        }
+        active.emplace_back(c);
+        inserted.first->second = c;
+        return c;
+    }
+
+    // return an empty chunk to the pool:
+    void release(uint32_t c)
+    {
+        Chunk& chunk = pool[c];
+        assert(chunk.occupied == 0);
+        index.erase(key(chunk.chunk_x, chunk.chunk_y));
+        // swap-remove from the active list:
+        uint32_t last = active.back();
+        active[chunk.active_index] = last;
+        pool[last].active_index = chunk.active_index;
+        active.pop_back();
+        free_chunks.emplace_back(c);
+    }
+};
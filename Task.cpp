@@ -0,0 +1,125 @@
+#include "Task.hpp"
+
+#include <cstring>
+
+void Task::sleep(double seconds) {
+	if (state == Done) return; //(stopped while running)
+	state = Sleeping;
+	timer = scheduler->timers.schedule(seconds, [this]() {
+		timer = 0;
+		scheduler->run(this);
+	});
+}
+
+void Task::recv(double timeout) {
+	if (state == Done) return; //(stopped while running)
+	state = Receiving;
+	received = false;
+	message_size = 0;
+	if (timeout > 0.0) {
+		timer = scheduler->timers.schedule(timeout, [this]() {
+			timer = 0;
+			scheduler->run(this);
+		});
+	}
+}
+
+void Task::finish() {
+	state = Done;
+}
+
+TaskScheduler::TaskScheduler(TimerWheel &timers_) : timers(timers_) {
+}
+
+TaskScheduler::~TaskScheduler() {
+	while (!by_connection.empty()) {
+		stop(by_connection.begin()->first);
+	}
+}
+
+bool TaskScheduler::deliver(Connection *connection, uint8_t const *data, size_t size) {
+	assert(size <= Task::MaxMessage && "messages for tasks should be small and of known size");
+	auto f = by_connection.find(connection);
+	if (f == by_connection.end()) return false;
+	for (Task *task = f->second; task; task = task->next_on_connection) {
+		if (task->state != Task::Receiving) continue;
+		if (task->timer) {
+			timers.cancel(task->timer);
+			task->timer = 0;
+		}
+		std::memcpy(task->message, data, size);
+		task->message_size = size;
+		task->received = true;
+		run(task);
+		return true;
+	}
+	return false;
+}
+
+void TaskScheduler::stop(Connection *connection) {
+	auto f = by_connection.find(connection);
+	if (f == by_connection.end()) return;
+	Task *task = f->second;
+	while (task) {
+		Task *next = task->next_on_connection;
+		if (task == current) {
+			//can't destroy it out from under its own resume(); run() cleans it up when that returns:
+			if (task->timer) {
+				timers.cancel(task->timer);
+				task->timer = 0;
+			}
+			task->state = Task::Done;
+		} else {
+			release(task);
+		}
+		task = next;
+	}
+}
+
+void *TaskScheduler::acquire() {
+	if (free_slots.empty()) {
+		constexpr size_t BlockSlots = 32;
+		blocks.emplace_back(new Slot[BlockSlots]);
+		for (size_t i = BlockSlots; i > 0; --i) {
+			free_slots.emplace_back(&blocks.back()[i - 1]);
+		}
+	}
+	void *slot = free_slots.back();
+	free_slots.pop_back();
+	return slot;
+}
+
+bool TaskScheduler::run(Task *task) {
+	Task *outer = current;
+	current = task;
+	task->state = Task::Running;
+	task->resume();
+	current = outer;
+	if (task->state == Task::Done) {
+		release(task);
+		return false;
+	}
+	return true;
+}
+
+void TaskScheduler::release(Task *task) {
+	if (task->timer) {
+		timers.cancel(task->timer);
+		task->timer = 0;
+	}
+	//unlink from its connection's list:
+	auto f = by_connection.find(task->connection);
+	assert(f != by_connection.end());
+	Task **at = &f->second;
+	while (*at != task) {
+		assert(*at);
+		at = &(*at)->next_on_connection;
+	}
+	*at = task->next_on_connection;
+	if (f->second == nullptr) by_connection.erase(f);
+
+	void *slot = dynamic_cast< void * >(task); //(start of the most-derived object, i.e., the slot)
+	task->~Task();
+	free_slots.emplace_back(slot);
+	running -= 1;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+/*
+ * Tasks let per-connection protocol logic (handshakes, pings, acks, ...) be written as
+ * straight-line code that waits on messages and timers, instead of as a state machine
+ * spread across poll() callbacks:
+ *  - a Task is a stackless coroutine: resume() picks up where the last wait left off, using
+ *    the TASK_* macros below; anything that must live across a wait is a member variable
+ *  - tasks run on the thread that calls poll(), from timers.advance() (sleeps and timeouts)
+ *    and from TaskScheduler::deliver() (messages); there are no threads or context switches
+ *  - task objects are constructed in fixed-size slots from the scheduler's pool, so starting
+ *    and finishing tasks doesn't allocate once the pool has grown to the number running at once
+ *
+ * (This is what C++20's co_await would give us; the build is C++17, so the resume point is
+ *  kept by hand, protothread-style: don't put a TASK_* wait inside a nested switch.)
+ *
+ * For example:
+
+struct Pinger : Task {
+	uint32_t round = 0;
+	void resume() override {
+		TASK_BEGIN();
+		for (round = 0; round < 10; ++round) {
+			connection->send('?');
+			TASK_RECV(2.0); //wait up to two seconds for the answer to be deliver()'d
+			if (!received) std::cout << "no answer!" << std::endl;
+			TASK_SLEEP(1.0);
+		}
+		TASK_END();
+	}
+};
+
+TaskScheduler tasks(server.timers);
+//on OnOpen:  tasks.start< Pinger >(c);
+//on OnRecv:  tasks.deliver(c, data, size);
+//on OnClose: tasks.stop(c);
+
+ */
+
+#include "TimerWheel.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct Connection;
+struct TaskScheduler;
+
+struct Task {
+	virtual ~Task() = default;
+
+	//run until the next TASK_* wait (or TASK_END):
+	virtual void resume() = 0;
+
+	Connection *connection = nullptr; //connection this task speaks for
+
+	//the message that ended the last TASK_RECV (if 'received'):
+	static constexpr size_t MaxMessage = 64;
+	uint8_t message[MaxMessage];
+	size_t message_size = 0;
+	bool received = false; //false if the last TASK_RECV timed out instead
+
+	//-- used by the TASK_* macros --
+	uint32_t resume_point = 0; //line of the wait to continue from (0 = start)
+	void sleep(double seconds);
+	void recv(double timeout);
+	void finish();
+
+	//-- internals (managed by TaskScheduler) --
+	enum State : uint8_t { Running, Sleeping, Receiving, Done } state = Running;
+	TaskScheduler *scheduler = nullptr;
+	TimerWheel::TimerId timer = 0; //pending wake-up, if any
+	Task *next_on_connection = nullptr; //other tasks for the same connection
+};
+
+#define TASK_BEGIN() switch (resume_point) { case 0:
+#define TASK_SLEEP(seconds) do { sleep(seconds); resume_point = __LINE__; return; case __LINE__:; } while (0)
+#define TASK_RECV(timeout) do { recv(timeout); resume_point = __LINE__; return; case __LINE__:; } while (0)
+#define TASK_END() } finish()
+
+struct TaskScheduler {
+	//slots are this big; bigger tasks don't compile:
+	static constexpr size_t SlotBytes = 256;
+
+	TaskScheduler(TimerWheel &timers);
+	~TaskScheduler();
+
+	TaskScheduler(TaskScheduler const &) = delete;
+	TaskScheduler &operator=(TaskScheduler const &) = delete;
+
+	//construct a T for 'connection' and run it up to its first wait:
+	// (returns nullptr if it finished without waiting)
+	template< typename T, typename... Args >
+	T *start(Connection *connection, Args &&... args) {
+		static_assert(sizeof(T) <= SlotBytes, "Task is too big for a TaskScheduler slot.");
+		static_assert(alignof(T) <= alignof(std::max_align_t), "Task is over-aligned for a TaskScheduler slot.");
+		T *task = new (acquire()) T(std::forward< Args >(args)...);
+		task->connection = connection;
+		task->scheduler = this;
+		Task *&head = by_connection[connection];
+		task->next_on_connection = head;
+		head = task;
+		running += 1;
+		return (run(task) ? task : nullptr);
+	}
+
+	//hand a message from 'connection' to its task that is waiting in TASK_RECV (if there is one):
+	// returns false (and drops the message) if none of the connection's tasks was waiting
+	bool deliver(Connection *connection, uint8_t const *data, size_t size);
+
+	//end every task for 'connection' (call when it closes; may be called from inside one of its tasks,
+	// which then ends at its next wait):
+	void stop(Connection *connection);
+
+	//number of tasks not yet finished:
+	size_t size() const { return running; }
+
+	//-- internals --
+	struct alignas(std::max_align_t) Slot {
+		uint8_t bytes[SlotBytes];
+	};
+	TimerWheel &timers;
+	std::vector< std::unique_ptr< Slot[] > > blocks; //slots are allocated a block at a time
+	std::vector< void * > free_slots;
+	std::unordered_map< Connection *, Task * > by_connection; //heads of each connection's task list
+	size_t running = 0;
+	Task *current = nullptr; //task whose resume() is on the stack (if any)
+
+	void *acquire();
+	bool run(Task *task); //resume; returns false (after cleaning up) if it finished
+	void release(Task *task); //unlink, destroy, and return the slot
+};
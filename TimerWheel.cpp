@@ -0,0 +1,166 @@
+#include "TimerWheel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+TimerWheel::TimerWheel(double resolution_) : resolution(resolution_), origin(Clock::now()) {
+	assert(resolution > 0.0);
+	std::fill(heads, heads + Levels * Slots, uint32_t(Nil));
+}
+
+uint64_t TimerWheel::tick_at(Clock::time_point when) const {
+	if (when <= origin) return 0;
+	double seconds = std::chrono::duration< double >(when - origin).count();
+	return uint64_t(std::ceil(seconds / resolution));
+}
+
+TimerWheel::TimerId TimerWheel::schedule(double delay, std::function< void() > const &callback) {
+	return schedule_at(Clock::now() + std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(std::max(0.0, delay))), callback);
+}
+
+TimerWheel::TimerId TimerWheel::schedule_at(Clock::time_point when, std::function< void() > const &callback) {
+	uint32_t index;
+	if (!free_nodes.empty()) {
+		index = free_nodes.back();
+		free_nodes.pop_back();
+	} else {
+		index = uint32_t(nodes.size());
+		nodes.emplace_back();
+	}
+	Node &node = nodes[index];
+	node.expires = tick_at(when);
+	node.callback = callback;
+	link(index);
+	pending += 1;
+	return (TimerId(node.generation) << 32) | TimerId(index);
+}
+
+TimerWheel::Node *TimerWheel::lookup(TimerId id) {
+	uint32_t index = uint32_t(id & 0xffffffff);
+	uint32_t generation = uint32_t(id >> 32);
+	if (index >= nodes.size()) return nullptr;
+	Node &node = nodes[index];
+	if (node.generation != generation || node.slot == Nil) return nullptr;
+	return &node;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+	if (!lookup(id)) return false;
+	uint32_t index = uint32_t(id & 0xffffffff);
+	unlink(index);
+	release(index);
+	return true;
+}
+
+bool TimerWheel::reschedule(TimerId id, double delay) {
+	Node *node = lookup(id);
+	if (!node) return false;
+	uint32_t index = uint32_t(id & 0xffffffff);
+	unlink(index);
+	node->expires = tick_at(Clock::now() + std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(std::max(0.0, delay))));
+	link(index);
+	return true;
+}
+
+void TimerWheel::link(uint32_t index, bool cascading) {
+	Node &node = nodes[index];
+
+	//current_tick has already been processed, so the soonest a new timer can fire is the tick after;
+	// cascades happen before current_tick's level-0 slot fires, so timers due now still make it:
+	uint64_t expires = std::max(node.expires, current_tick + (cascading ? 0 : 1));
+	uint64_t delta = expires - current_tick;
+
+	//pick the finest level whose wheel spans the delay:
+	uint32_t level = 0;
+	while (level + 1 < Levels && delta >= (uint64_t(1) << (SlotBits * (level + 1)))) {
+		level += 1;
+	}
+	//timers beyond the top wheel's span park in its last slot and get re-linked when it cascades:
+	uint64_t top_span = uint64_t(1) << (SlotBits * Levels);
+	if (delta >= top_span) expires = current_tick + top_span - 1;
+
+	uint32_t slot = level * Slots + uint32_t((expires >> (SlotBits * level)) & (Slots - 1));
+
+	node.slot = slot;
+	node.prev = Nil;
+	node.next = heads[slot];
+	if (node.next != Nil) nodes[node.next].prev = index;
+	heads[slot] = index;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+	Node &node = nodes[index];
+	assert(node.slot != Nil);
+	if (node.prev != Nil) nodes[node.prev].next = node.next;
+	else heads[node.slot] = node.next;
+	if (node.next != Nil) nodes[node.next].prev = node.prev;
+	node.prev = node.next = node.slot = Nil;
+}
+
+void TimerWheel::release(uint32_t index) {
+	Node &node = nodes[index];
+	node.callback = nullptr;
+	node.generation += 1;
+	if (node.generation == 0) node.generation = 1; //keep ids nonzero
+	free_nodes.emplace_back(index);
+	assert(pending > 0);
+	pending -= 1;
+}
+
+void TimerWheel::advance(Clock::time_point now) {
+	//process every tick that has fully started by 'now':
+	double seconds = std::chrono::duration< double >(now - origin).count();
+	uint64_t target = (seconds > 0.0 ? uint64_t(std::floor(seconds / resolution)) : 0);
+
+	while (current_tick < target) {
+		//nothing scheduled? skip straight to the target:
+		if (pending == 0) {
+			current_tick = target;
+			break;
+		}
+
+		current_tick += 1;
+
+		//cascade timers from coarser wheels whose slot comes up on this tick:
+		for (uint32_t level = Levels - 1; level > 0; --level) {
+			if (current_tick & ((uint64_t(1) << (SlotBits * level)) - 1)) continue;
+			uint32_t slot = level * Slots + uint32_t((current_tick >> (SlotBits * level)) & (Slots - 1));
+			uint32_t index = heads[slot];
+			heads[slot] = Nil;
+			while (index != Nil) {
+				uint32_t next = nodes[index].next;
+				link(index, true);
+				index = next;
+			}
+		}
+
+		//fire everything in this tick's level-0 slot:
+		uint32_t slot = uint32_t(current_tick & (Slots - 1));
+		while (heads[slot] != Nil) {
+			uint32_t index = heads[slot];
+			unlink(index);
+			std::function< void() > callback = std::move(nodes[index].callback);
+			release(index);
+			if (callback) callback();
+		}
+	}
+}
+
+double TimerWheel::time_until_next(double max_wait, Clock::time_point now) const {
+	if (pending == 0) return max_wait;
+
+	auto seconds_until = [&](uint64_t tick) {
+		double at = double(tick) * resolution - std::chrono::duration< double >(now - origin).count();
+		return std::max(0.0, at);
+	};
+
+	//look through the next rotation of the level-0 wheel; stop early at a cascade, since
+	// that may bring in timers that are due sooner than anything found later in the scan:
+	for (uint64_t tick = current_tick + 1; tick <= current_tick + Slots; ++tick) {
+		if (heads[tick & (Slots - 1)] != Nil || (tick & (Slots - 1)) == 0) {
+			return std::min(max_wait, seconds_until(tick));
+		}
+	}
+	return std::min(max_wait, seconds_until(current_tick + Slots));
+}
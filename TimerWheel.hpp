@@ -0,0 +1,86 @@
+#pragma once
+
+/*
+ * TimerWheel is a hierarchical timing wheel for scheduling callbacks:
+ *  - schedule, cancel, and reschedule are all O(1)
+ *  - advance() does a constant amount of work per elapsed tick (plus the timers it fires)
+ *  - time_until_next() gives a poll() timeout that wakes up in time for the next timer
+ *
+ * Timers live in one of Levels wheels of Slots slots each; level L slots are Slots^L ticks wide.
+ * As time advances, timers cascade from coarser to finer wheels until they fire from level 0.
+ *
+ * For example:
+
+TimerWheel timers;
+TimerWheel::TimerId id = timers.schedule(2.5, [](){ std::cout << "ding!" << std::endl; });
+while (true) {
+	server.poll(on_event, timers.time_until_next(1.0));
+	timers.advance(); //will print "ding!" once, after 2.5 seconds
+}
+
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct TimerWheel {
+	using Clock = std::chrono::steady_clock;
+	typedef uint64_t TimerId; //zero is never a valid id, so it can be used for "no timer"
+
+	//resolution is the length of one tick, in seconds:
+	TimerWheel(double resolution = 0.001);
+
+	//call 'callback' once, 'delay' seconds from now (or at 'when'):
+	TimerId schedule(double delay, std::function< void() > const &callback);
+	TimerId schedule_at(Clock::time_point when, std::function< void() > const &callback);
+
+	//stop a timer from firing; returns false if it already fired or was cancelled:
+	bool cancel(TimerId id);
+
+	//move a pending timer to 'delay' seconds from now, keeping its callback and id;
+	// returns false if it already fired or was cancelled:
+	bool reschedule(TimerId id, double delay);
+
+	//fire all timers that are due at 'now':
+	// (callbacks may freely schedule or cancel timers)
+	void advance(Clock::time_point now = Clock::now());
+
+	//seconds until advance() might have something to do, at most 'max_wait':
+	double time_until_next(double max_wait, Clock::time_point now = Clock::now()) const;
+
+	//number of pending timers:
+	size_t size() const { return pending; }
+
+	//-- internals --
+	enum : uint32_t {
+		SlotBits = 6,
+		Slots = 1 << SlotBits,
+		Levels = 4,
+		Nil = 0xffffffff,
+	};
+
+	struct Node {
+		uint64_t expires = 0; //tick at which to fire
+		uint32_t prev = Nil, next = Nil; //links within slot list
+		uint32_t slot = Nil; //level * Slots + index of slot holding this node (Nil if free)
+		uint32_t generation = 1; //bumped every time the node is released, so stale ids don't match
+		std::function< void() > callback;
+	};
+
+	double resolution;
+	Clock::time_point origin; //time of tick 0
+	uint64_t current_tick = 0; //all ticks up to and including this one have been processed
+
+	std::vector< Node > nodes;
+	std::vector< uint32_t > free_nodes;
+	uint32_t heads[Levels * Slots];
+	size_t pending = 0;
+
+	uint64_t tick_at(Clock::time_point when) const;
+	Node *lookup(TimerId id);
+	void link(uint32_t index, bool cascading = false); //(cascading: re-linking during advance(), before current_tick's slot fires)
+	void unlink(uint32_t index);
+	void release(uint32_t index);
+};
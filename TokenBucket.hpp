@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+// Token bucket rate limiter:
+//  holds up to 'burst' tokens, refilled at 'rate' tokens per second;
+//  every action takes a token, and actions are refused while the bucket is empty.
+struct TokenBucket {
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket(float rate_, float burst_)
+        : rate(rate_)
+        , burst(burst_)
+        , tokens(burst_)
+    {
+    }
+
+    float rate; // tokens per second
+    float burst; // bucket capacity
+    float tokens;
+    Clock::time_point last_refill = Clock::now();
+
+    void refill(Clock::time_point now)
+    {
+        float elapsed = std::chrono::duration<float>(now - last_refill).count();
+        if (elapsed <= 0.0f)
+            return;
+        tokens = std::min(burst, tokens + elapsed * rate);
+        last_refill = now;
+    }
+
+    // is there a token to spend right now?
+    bool ready(Clock::time_point now = Clock::now())
+    {
+        refill(now);
+        return tokens >= 1.0f;
+    }
+
+    // spend a token (only call after ready() returned true):
+    void take()
+    {
+        tokens -= 1.0f;
+    }
+};
@@ -0,0 +1,307 @@
+// bench-net: loopback benchmarks for Connection.cpp
+//  - ping-pong: one client bounces a small message off the server (round-trip latency)
+//  - bulk: one client streams messages to the server as fast as it will take them (throughput)
+//  - fan-out: the server sends a board-sized message to many clients at once (broadcast cost)
+// Server and clients are polled from this one thread, so latencies include both ends' work
+// and CPU/msg is the whole process's CPU time divided by the messages delivered.
+
+#include "Connection.hpp"
+#include "Game.hpp" // BOARD_WIDTH, BOARD_HEIGHT
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h> // getpid
+#endif
+
+namespace {
+
+uint64_t now_ns()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// benchmark messages: (uint32 size) (uint64 send time, ns) (size - 8 bytes of payload)
+constexpr size_t HeaderBytes = 4;
+constexpr size_t StampBytes = 8;
+
+void send_message(Connection* c, uint64_t stamp, size_t payload)
+{
+    uint32_t size = uint32_t(StampBytes + payload);
+    c->send(size);
+    c->send(stamp);
+    c->send_buffer.resize(c->send_buffer.size() + payload, 0x5a);
+}
+
+// call 'on_message(stamp, whole message)' for every complete message in recv_buffer, then erase them all at once:
+template <typename F>
+size_t consume_messages(Connection* c, F const& on_message)
+{
+    size_t at = 0, count = 0;
+    auto& buf = c->recv_buffer;
+    while (buf.size() - at >= HeaderBytes + StampBytes) {
+        uint32_t size;
+        std::memcpy(&size, &buf[at], sizeof(size));
+        if (buf.size() - at < HeaderBytes + size)
+            break;
+        uint64_t stamp;
+        std::memcpy(&stamp, &buf[at + HeaderBytes], sizeof(stamp));
+        on_message(stamp, &buf[at], HeaderBytes + size);
+        at += HeaderBytes + size;
+        count++;
+    }
+    buf.erase(buf.begin(), buf.begin() + at);
+    return count;
+}
+
+struct Stats {
+    std::vector<double> latencies_us;
+    uint64_t start_ns = now_ns();
+    std::clock_t start_cpu = std::clock();
+
+    void report(std::string const& name)
+    {
+        double wall = double(now_ns() - start_ns) * 1e-9;
+        double cpu = double(std::clock() - start_cpu) / CLOCKS_PER_SEC;
+        size_t count = latencies_us.size();
+        std::sort(latencies_us.begin(), latencies_us.end());
+        auto percentile = [&](double p) {
+            if (latencies_us.empty())
+                return 0.0;
+            size_t i = std::min(count - 1, size_t(p * double(count)));
+            return latencies_us[i];
+        };
+        std::printf("%-34s p50 %9.1fus  p99 %9.1fus  p999 %9.1fus  %11.0f msgs/s  %7.2fus CPU/msg\n",
+            name.c_str(), percentile(0.50), percentile(0.99), percentile(0.999),
+            count / wall, (count ? cpu * 1e6 / count : 0.0));
+        std::fflush(stdout);
+    }
+};
+
+// poll the server and every client once, without waiting:
+void poll_all(Server& server, std::vector<std::unique_ptr<Client>>& clients,
+    std::function<void(Connection*, Connection::Event)> const& on_server,
+    std::function<void(size_t, Connection*, Connection::Event)> const& on_client)
+{
+    server.poll(on_server, 0.0);
+    for (size_t i = 0; i < clients.size(); i++) {
+        clients[i]->poll([&](Connection* c, Connection::Event evt) {
+            if (evt == Connection::OnClose)
+                throw std::runtime_error("bench-net: client lost its connection");
+            on_client(i, c, evt);
+        },
+            0.0);
+    }
+}
+
+std::vector<std::unique_ptr<Client>> connect_clients(Server& server, std::string const& host, std::string const& port, size_t count)
+{
+    std::vector<std::unique_ptr<Client>> clients;
+    for (size_t i = 0; i < count; i++) {
+        // the Client constructor blocks until the server answers (shared-memory clients wait for
+        // their rings), so construct it on a helper thread while this one runs the server:
+        std::unique_ptr<Client> client;
+        std::exception_ptr error;
+        std::atomic<bool> done(false);
+        std::thread connect([&]() {
+            try {
+                client = std::make_unique<Client>(host, port);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            done = true;
+        });
+        // (accept before connecting the next one so the listen backlog never overflows)
+        while (!done || server.connections.size() < clients.size() + 1) {
+            server.poll(nullptr, 0.01);
+            if (done && error)
+                break;
+        }
+        connect.join();
+        if (error)
+            std::rethrow_exception(error);
+        clients.emplace_back(std::move(client));
+    }
+    return clients;
+}
+
+void disconnect_clients(Server& server, std::vector<std::unique_ptr<Client>>& clients)
+{
+    for (auto& client : clients) {
+        client->connection.close();
+    }
+    clients.clear();
+    while (!server.connections.empty()) {
+        server.poll(nullptr, 0.01);
+    }
+}
+
+void ping_pong(Server& server, std::string const& host, std::string const& port, size_t payload, size_t round_trips)
+{
+    auto clients = connect_clients(server, host, port, 1);
+    Connection* client = &clients[0]->connection;
+
+    auto echo = [](Connection* c, Connection::Event evt) {
+        if (evt != Connection::OnRecv)
+            return;
+        consume_messages(c, [&](uint64_t, uint8_t const* data, size_t size) {
+            c->send_buffer.insert(c->send_buffer.end(), data, data + size);
+        });
+    };
+
+    Stats stats;
+    for (size_t i = 0; i < round_trips; i++) {
+        send_message(client, now_ns(), payload);
+        bool got = false;
+        while (!got) {
+            poll_all(server, clients, echo, [&](size_t, Connection* c, Connection::Event evt) {
+                if (evt != Connection::OnRecv)
+                    return;
+                consume_messages(c, [&](uint64_t stamp, uint8_t const*, size_t) {
+                    stats.latencies_us.emplace_back(double(now_ns() - stamp) * 1e-3);
+                    got = true;
+                });
+            });
+        }
+    }
+    stats.report("ping-pong (" + std::to_string(payload) + " B round trip)");
+    disconnect_clients(server, clients);
+}
+
+void bulk(Server& server, std::string const& host, std::string const& port, size_t payload, size_t messages)
+{
+    auto clients = connect_clients(server, host, port, 1);
+    Connection* client = &clients[0]->connection;
+    constexpr size_t MaxQueued = 1 << 20; // keep the client's send_buffer from growing without bound
+
+    Stats stats;
+    size_t sent = 0;
+    auto sink = [&](Connection* c, Connection::Event evt) {
+        if (evt != Connection::OnRecv)
+            return;
+        consume_messages(c, [&](uint64_t stamp, uint8_t const*, size_t) {
+            stats.latencies_us.emplace_back(double(now_ns() - stamp) * 1e-3);
+        });
+    };
+    while (stats.latencies_us.size() < messages) {
+        while (sent < messages && client->send_buffer.size() < MaxQueued) {
+            send_message(client, now_ns(), payload);
+            sent++;
+        }
+        poll_all(server, clients, sink, [](size_t, Connection*, Connection::Event) {});
+    }
+    stats.report("bulk (" + std::to_string(payload) + " B one way)");
+    disconnect_clients(server, clients);
+}
+
+void fan_out(Server& server, std::string const& host, std::string const& port, size_t payload, size_t client_count, size_t rounds)
+{
+    auto clients = connect_clients(server, host, port, client_count);
+
+    Stats stats;
+    size_t received = 0;
+    auto on_client = [&](size_t, Connection* c, Connection::Event evt) {
+        if (evt != Connection::OnRecv)
+            return;
+        received += consume_messages(c, [&](uint64_t stamp, uint8_t const*, size_t) {
+            stats.latencies_us.emplace_back(double(now_ns() - stamp) * 1e-3);
+        });
+    };
+    for (size_t round = 0; round < rounds; round++) {
+        uint64_t stamp = now_ns();
+        for (auto& c : server.connections) {
+            send_message(&c, stamp, payload);
+        }
+        size_t expected = (round + 1) * client_count;
+        while (received < expected) {
+            poll_all(server, clients, nullptr, on_client);
+        }
+    }
+    stats.report("fan-out (" + std::to_string(payload) + " B to " + std::to_string(client_count) + " clients)");
+    disconnect_clients(server, clients);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+#ifdef _WIN32
+    // when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+    try {
+#endif
+        //------------ argument parsing ------------
+        std::string port = "15467";
+        bool use_shm = false;
+        size_t fan_out_clients = 32;
+        size_t scale = 1;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--shm") {
+                use_shm = true;
+            } else if (arg == "--port" && i + 1 < argc) {
+                port = argv[++i];
+            } else if (arg == "--clients" && i + 1 < argc) {
+                fan_out_clients = std::stoul(argv[++i]);
+            } else if (arg == "--scale" && i + 1 < argc) {
+                scale = std::max<size_t>(1, std::stoul(argv[++i]));
+            } else {
+                std::cerr << "Usage:\n\t./bench-net [--port <port>] [--shm] [--clients <fan-out clients>] [--scale <iteration multiplier>]" << std::endl;
+                return 1;
+            }
+        }
+
+        //------------ set up ------------
+        Server server(port);
+        std::string host = "localhost";
+        std::string local_path;
+        if (use_shm) {
+#ifdef _WIN32
+            throw std::runtime_error("--shm is not supported on this platform.");
+#else
+            local_path = "/tmp/bench-net-" + std::to_string(getpid()) + ".sock";
+            server.listen_local(local_path);
+            host = "unix:" + local_path;
+#endif
+        }
+        // the benchmark wants to measure the transport, not the server's per-client limits:
+        server.read_budget = 0;
+        server.recv_buffer_limit = 0;
+
+        std::cout << "bench-net over " << (use_shm ? "shared memory" : "TCP loopback") << ":" << std::endl;
+
+        //------------ scenarios ------------
+        ping_pong(server, host, port, 64, 20000 * scale);
+        bulk(server, host, port, 1024, 200000 * scale);
+        fan_out(server, host, port, 4 + BOARD_WIDTH * BOARD_HEIGHT, fan_out_clients, 2000 * scale);
+
+#ifndef _WIN32
+        if (!local_path.empty())
+            unlink(local_path.c_str());
+#endif
+
+        return 0;
+
+#ifdef _WIN32
+    } catch (std::exception const& e) {
+        std::cerr << "Unhandled exception:\n"
+                  << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "Unhandled exception (unknown type)." << std::endl;
+        throw;
+    }
+#endif
+}
@@ -0,0 +1,98 @@
+// board-mirror: prints what a server started with --mirror <file> is publishing.
+//  - maps the mirror file read-only; the server never waits on (or even knows about) readers
+//  - shows the tick, the player table, and the board ('.' empty, digits = explorers, '$' = treasure)
+// With --watch it keeps printing every new tick, which makes it a starting point for local
+// analytics or admin tools that would otherwise have to connect as clients.
+
+#include "BoardMirror.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+void print_snapshot(BoardMirror::Snapshot const& snapshot)
+{
+    std::printf("tick %u, %u players:\n", snapshot.tick, uint32_t(snapshot.players.size()));
+    for (auto const& player : snapshot.players) {
+        std::string rtt = (player.rtt_ms == 0xffff ? std::string("?") : std::to_string(player.rtt_ms));
+        if (player.pos_x == 0xff) {
+            std::printf("  %-20.20s (not placed)  found %d  rtt %s ms\n", player.name, player.total, rtt.c_str());
+        } else {
+            std::printf("  %-20.20s at (%2u, %2u)   found %d  rtt %s ms\n", player.name, player.pos_x, player.pos_y, player.total, rtt.c_str());
+        }
+    }
+    // (highest row first)
+    for (uint32_t y = snapshot.height; y-- > 0;) {
+        std::string row(snapshot.width, '.');
+        for (uint32_t x = 0; x < snapshot.width; x++) {
+            int8_t tile = int8_t(snapshot.board[x + y * snapshot.width]);
+            if (tile < 0) {
+                row[x] = '$';
+            } else if (tile > 0) {
+                row[x] = (tile > 9 ? '+' : char('0' + tile));
+            }
+        }
+        std::printf("  %s\n", row.c_str());
+    }
+    std::fflush(stdout);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+#ifdef _WIN32
+    // when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+    try {
+#endif
+
+        //------------ argument parsing ------------
+
+        bool watch = (argc == 3 && std::string(argv[2]) == "--watch");
+        if (argc != 2 && !watch) {
+            std::cerr << "Usage:\n\t./board-mirror <file> [--watch]" << std::endl;
+            std::cerr << "\t(<file> is the path given to ./server --mirror)" << std::endl;
+            return 1;
+        }
+
+        //------------ read ------------
+
+        BoardMirrorReader reader(argv[1]);
+        BoardMirror::Snapshot snapshot;
+
+        // how often --watch checks for a new tick:
+        constexpr float WatchInterval = 0.1f;
+
+        uint32_t last_tick = 0;
+        bool printed = false;
+        do {
+            if (reader.read(&snapshot) && (!printed || snapshot.tick != last_tick)) {
+                print_snapshot(snapshot);
+                last_tick = snapshot.tick;
+                printed = true;
+            } else if (!watch) {
+                std::cerr << "Nothing has been published to '" << argv[1] << "' yet." << std::endl;
+                return 1;
+            }
+            if (watch)
+                std::this_thread::sleep_for(std::chrono::duration<float>(WatchInterval));
+        } while (watch);
+
+        return 0;
+
+#ifdef _WIN32
+    } catch (std::exception const& e) {
+        std::cerr << "Unhandled exception:\n"
+                  << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "Unhandled exception (unknown type)." << std::endl;
+        throw;
+    }
+#endif
+}
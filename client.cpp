@@ -1,6 +1,7 @@
 #include "PlayMode.hpp"
 
 #include "Connection.hpp"
+#include "Game.hpp"
 #include "GL.hpp"
 #include "Load.hpp"
 #include "Mode.hpp"
@@ -37,13 +38,33 @@ int main(int argc, char** argv)
     try {
 #endif
         //------------ command line arguments ------------
-        if (argc != 3) {
-            std::cerr << "Usage:\n\t./client <host> <port>" << std::endl;
+        bool spectate = false;
+        std::string room; // (empty = don't name one)
+        bool bad_args = (argc < 3);
+        for (int i = 3; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--spectate") {
+                spectate = true;
+            } else if (arg == "--room" && i + 1 < argc) {
+                room = argv[++i];
+            } else {
+                bad_args = true;
+            }
+        }
+        if (bad_args) {
+            std::cerr << "Usage:\n\t./client <host> <port> [--spectate] [--room <name>]" << std::endl;
+            std::cerr << "\t(use unix:<path> as the host to reach a server on this machine through shared memory)" << std::endl;
+            std::cerr << "\t(--spectate watches without playing; point it at a ./relay to keep load off the server)" << std::endl;
+            std::cerr << "\t(--room picks a room when <host> <port> is a ./router)" << std::endl;
             return 1;
         }
 
         //------------ connect to server --------------
         Client client(argv[1], argv[2]);
+        // (a router picks the server based on this, so it goes ahead of everything else)
+        if (!room.empty()) {
+            send_join(&client.connection, room);
+        }
 
         //------------  initialization ------------
 
@@ -112,7 +133,7 @@ int main(int argc, char** argv)
         call_load_functions();
 
         //------------ create game mode + make current --------------
-        Mode::set_current(std::make_shared<PlayMode>(client));
+        Mode::set_current(std::make_shared<PlayMode>(client, spectate));
 
         //------------ main loop ------------
 
@@ -0,0 +1,134 @@
+// relay: re-broadcasts a server's board messages to read-only viewers.
+//  - connects upstream (to a server or to another relay) as a single spectator
+//  - forwards every board message, byte-for-byte, to all of its own viewers
+//  - keeps the last board message so new viewers see the board right away
+// Viewers are spectating clients (./client <host> <port> --spectate) or further relays,
+// so relays can be chained into a tree and the server's egress stays one send per relay.
+
+#include "Connection.hpp"
+#include "Game.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+#ifdef _WIN32
+    // when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+    try {
+#endif
+
+        //------------ argument parsing ------------
+
+        if (argc != 4 && argc != 5) {
+            std::cerr << "Usage:\n\t./relay <upstream host> <upstream port> <port> [local-socket-path]" << std::endl;
+            std::cerr << "\t(upstream may be a server or another relay; viewers connect to <port> with ./client <host> <port> --spectate)" << std::endl;
+            return 1;
+        }
+
+        //------------ initialization ------------
+
+        Client upstream(argv[1], argv[2]);
+        // say hello as a spectator; the upstream then only ever sends board messages:
+        upstream.connection.send(Message::C2S_Spectate);
+
+        Server server(argv[3]);
+        if (argc == 5) {
+            server.listen_local(argv[4]);
+        }
+        // viewers say hello right away and repeat it every couple of seconds:
+        server.handshake_timeout = 5.0;
+        server.idle_timeout = 10.0;
+
+        // the hello doubles as a keepalive, so the upstream doesn't time the relay out:
+        constexpr float UpstreamKeepaliveInterval = 2.0f;
+        // longest the relay waits on the upstream before servicing viewers anyway:
+        constexpr double UpstreamPollWait = 0.01;
+        // a viewer that has fallen this far behind is dropped rather than buffered without bound:
+        constexpr size_t MaxViewerBacklog = 64 * 1024;
+
+        // relay state:
+        std::vector<uint8_t> last_board; // most recent board message, exactly as received
+        std::unordered_set<Connection*> viewers; // connections that have said hello
+        auto last_keepalive = std::chrono::steady_clock::now();
+        size_t forwarded = 0;
+
+        //------------ main loop ------------
+        while (true) {
+            // wait on the upstream, so board messages are forwarded as soon as they arrive:
+            upstream.poll([&](Connection* c, Connection::Event evt) {
+                if (evt == Connection::OnClose) {
+                    throw std::runtime_error("Lost connection to upstream.");
+                }
+                if (evt != Connection::OnRecv)
+                    return;
+                while (size_t length = board_message_length(c->recv_buffer)) {
+                    last_board.assign(c->recv_buffer.begin(), c->recv_buffer.begin() + length);
+                    c->recv_buffer.erase(c->recv_buffer.begin(), c->recv_buffer.begin() + length);
+                    for (Connection* viewer : viewers) {
+                        viewer->send_buffer.insert(viewer->send_buffer.end(), last_board.begin(), last_board.end());
+                    }
+                    forwarded += 1;
+                }
+            },
+                UpstreamPollWait);
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_keepalive >= std::chrono::duration<double>(UpstreamKeepaliveInterval)) {
+                last_keepalive = now;
+                upstream.connection.send(Message::C2S_Spectate);
+            }
+
+            // drop viewers that can't keep up:
+            for (auto it = viewers.begin(); it != viewers.end(); /* later */) {
+                Connection* c = *it;
+                if (c->send_buffer.size() > MaxViewerBacklog) {
+                    std::cout << "[relay] viewer on " << c->socket << " is " << c->send_buffer.size() << " bytes behind; disconnecting." << std::endl;
+                    c->close();
+                    it = viewers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            // then accept viewers, read their hellos, and push out what was forwarded:
+            server.poll([&](Connection* c, Connection::Event evt) {
+                if (evt == Connection::OnClose) {
+                    viewers.erase(c);
+                } else if (evt == Connection::OnRecv) {
+                    // viewers only ever send hellos:
+                    auto end = std::find_if(c->recv_buffer.begin(), c->recv_buffer.end(), [](uint8_t b) { return b != uint8_t(Message::C2S_Spectate); });
+                    bool bad = (end != c->recv_buffer.end());
+                    bool hello = (end != c->recv_buffer.begin());
+                    c->recv_buffer.erase(c->recv_buffer.begin(), end);
+                    if (bad) {
+                        std::cout << "[relay] viewer on " << c->socket << " sent something other than a hello; disconnecting." << std::endl;
+                        c->close();
+                        viewers.erase(c);
+                    } else if (hello && viewers.insert(c).second) {
+                        // new viewer: catch it up with the cached board
+                        c->send_buffer.insert(c->send_buffer.end(), last_board.begin(), last_board.end());
+                        std::cout << "[relay] " << viewers.size() << " viewers (" << forwarded << " boards forwarded so far)." << std::endl;
+                    }
+                }
+            },
+                0.0);
+        }
+
+        return 0;
+
+#ifdef _WIN32
+    } catch (std::exception const& e) {
+        std::cerr << "Unhandled exception:\n"
+                  << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "Unhandled exception (unknown type)." << std::endl;
+        throw;
+    }
+#endif
+}
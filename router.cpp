@@ -0,0 +1,186 @@
+// router: spreads clients over several servers, so a tournament can run more rooms than one machine can.
+//  - servers started with --router <router host> <router port> register the room they host and the
+//    address to reach them at, then report how many connections they're handling every second
+//  - clients connect to the router instead of a server (./client <router host> <router port> [--room <name>])
+//  - each client is proxied, byte-for-byte, to the least-loaded server hosting its room
+// The router never looks inside the game's messages (other than an optional leading room name),
+// so it works the same for players, spectators, relays, and lockstep servers.
+
+#include "Connection.hpp"
+#include "Game.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+#ifdef _WIN32
+    // when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+    try {
+#endif
+
+        //------------ argument parsing ------------
+
+        if (argc != 2) {
+            std::cerr << "Usage:\n\t./router <port>" << std::endl;
+            std::cerr << "\t(start servers with ./server <port> --router <router host> <router port> [--room <name>];" << std::endl;
+            std::cerr << "\t clients then connect to the router with ./client <router host> <router port> [--room <name>])" << std::endl;
+            return 1;
+        }
+
+        //------------ initialization ------------
+
+        Server server(argv[1]);
+        // clients say hello right away and keep the connection alive every couple of seconds;
+        // servers register right away and report once a second:
+        server.handshake_timeout = 5.0;
+        server.idle_timeout = 10.0;
+
+        // connections to servers share the router's poll set (see Server::connect_to), so one wait covers
+        // both sides; poll() also wakes for timers, so this is just an upper bound:
+        constexpr double PollWait = 1.0;
+
+        // a server that has registered with the router:
+        struct Instance {
+            std::string room, host, port;
+            uint32_t load = 0; // connections, as of its last report
+            uint32_t routed = 0; // clients sent its way since its last report (so a burst doesn't all land on one server)
+        };
+        std::unordered_map<Connection*, Instance> instances; // by the connection the server reports on
+
+        // a client being proxied to a server:
+        struct Route {
+            Connection* upstream; // (in server.connections, alongside the clients)
+            std::string room;
+        };
+        std::unordered_map<Connection*, Route> routes; // by client connection
+        std::unordered_map<Connection*, Connection*> upstreams; // client connection, by upstream connection
+
+        // connect 'c' to the least-loaded server hosting 'room'; returns false if there isn't one to be had:
+        auto route = [&](Connection* c, std::string const& room) -> bool {
+            Instance* best = nullptr;
+            for (auto& [report, instance] : instances) {
+                (void)report;
+                if (instance.room != room)
+                    continue;
+                if (!best || instance.load + instance.routed < best->load + best->routed)
+                    best = &instance;
+            }
+            if (!best) {
+                std::cout << "[router] no server hosts room '" << room << "'; disconnecting client on " << c->socket << "." << std::endl;
+                return false;
+            }
+            // (doesn't wait for the connection to go through; if it fails, the client is dropped then)
+            Connection* upstream = nullptr;
+            try {
+                upstream = server.connect_to(best->host, best->port);
+            } catch (std::exception const& e) {
+                std::cout << "[router] couldn't reach " << best->host << ":" << best->port << " (" << e.what() << ")." << std::endl;
+                return false;
+            }
+            best->routed += 1;
+            // pass along whatever the client has sent so far:
+            upstream->send_buffer.swap(c->recv_buffer);
+            routes.emplace(c, Route { upstream, room });
+            upstreams.emplace(upstream, c);
+            std::cout << "[router] client on " << c->socket << " -> " << best->host << ":" << best->port << " (room '" << room << "', " << best->load << "+" << best->routed << " connections)." << std::endl;
+            return true;
+        };
+
+        // end a route (when either side hangs up):
+        auto drop_route = [&](Connection* c) {
+            auto f = routes.find(c);
+            if (f == routes.end())
+                return;
+            upstreams.erase(f->second.upstream);
+            f->second.upstream->close();
+            c->close();
+            routes.erase(f);
+        };
+
+        //------------ main loop ------------
+        while (true) {
+            server.poll([&](Connection* c, Connection::Event evt) {
+                // a server a client is routed to:
+                auto u = upstreams.find(c);
+                if (u != upstreams.end()) {
+                    Connection* client = u->second;
+                    if (evt == Connection::OnClose) {
+                        drop_route(client);
+                    } else if (evt == Connection::OnRecv) {
+                        client->send_buffer.insert(client->send_buffer.end(), c->recv_buffer.begin(), c->recv_buffer.end());
+                        c->recv_buffer.clear();
+                    }
+                    return;
+                }
+
+                if (evt == Connection::OnClose) {
+                    auto f = instances.find(c);
+                    if (f != instances.end()) {
+                        std::cout << "[router] " << f->second.host << ":" << f->second.port << " (room '" << f->second.room << "') is gone." << std::endl;
+                        instances.erase(f);
+                    }
+                    drop_route(c);
+                    return;
+                }
+                if (evt != Connection::OnRecv)
+                    return;
+
+                // a client that is already routed: forward everything
+                auto r = routes.find(c);
+                if (r != routes.end()) {
+                    auto& send_buffer = r->second.upstream->send_buffer;
+                    send_buffer.insert(send_buffer.end(), c->recv_buffer.begin(), c->recv_buffer.end());
+                    c->recv_buffer.clear();
+                    return;
+                }
+
+                // a server reporting in:
+                auto f = instances.find(c);
+                if (f != instances.end()) {
+                    while (recv_load(c, &f->second.load)) {
+                        f->second.routed = 0;
+                    }
+                    if (!c->recv_buffer.empty() && c->recv_buffer[0] != uint8_t(Message::S2R_Load)) {
+                        std::cout << "[router] unexpected message from " << f->second.host << ":" << f->second.port << "; disconnecting." << std::endl;
+                        c->close();
+                        instances.erase(f);
+                    }
+                    return;
+                }
+
+                // something new; the first message says what it is:
+                Message type = Message(c->recv_buffer[0]);
+                if (type == Message::S2R_Register) {
+                    Instance instance;
+                    if (!recv_register(c, &instance.room, &instance.host, &instance.port))
+                        return; // wait for the rest of it
+                    std::cout << "[router] " << instance.host << ":" << instance.port << " hosts room '" << instance.room << "'." << std::endl;
+                    instances.emplace(c, instance);
+                    return;
+                }
+                std::string room = DefaultRoom;
+                if (type == Message::C2S_Join && !recv_join(c, &room))
+                    return; // wait for the rest of it
+                if (!route(c, room))
+                    c->close();
+            },
+                PollWait);
+        }
+
+        return 0;
+
+#ifdef _WIN32
+    } catch (std::exception const& e) {
+        std::cerr << "Unhandled exception:\n"
+                  << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "Unhandled exception (unknown type)." << std::endl;
+        throw;
+    }
+#endif
+}
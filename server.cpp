@@ -1,21 +1,90 @@
 
+#include "BoardMirror.hpp"
+#include "Checkpoint.hpp"
 #include "Connection.hpp"
-#include "PlayMode.hpp" // BOARD_WIDTH, BOARD_HEIGHT
+#include "FlowField.hpp"
+#include "Game.hpp"
+#include "SparseGrid.hpp"
+#include "Task.hpp"
+#include "TokenBucket.hpp"
 
 #include "hex_dump.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <time.h>
 #include <unordered_map>
+#include <unordered_set>
 
 #ifdef _WIN32
 extern "C" {
 uint32_t GetACP();
 }
 #endif
+
+// measures a player's round-trip time: pings every PingInterval and waits for the matching pong:
+struct PingTask : Task {
+    static constexpr double PingInterval = 1.0;
+    static constexpr double PingTimeout = 2.0;
+
+    PingTask(float* rtt_ms_)
+        : rtt_ms(rtt_ms_)
+    {
+    }
+    float* rtt_ms; // smoothed round-trip time, in milliseconds (negative until the first pong)
+
+    uint32_t ping_id = 0;
+    std::chrono::steady_clock::time_point sent_at;
+    double wait = 0.0; // (TASK_RECV waits forever if given zero, so the timeout is checked first)
+
+    void resume() override
+    {
+        TASK_BEGIN();
+        while (true) {
+            TASK_SLEEP(PingInterval);
+            ping_id += 1;
+            send_ping(connection, Message::S2C_Ping, ping_id);
+            sent_at = std::chrono::steady_clock::now();
+            // (pongs for earlier pings that show up late are skipped, without extending the wait)
+            do {
+                wait = time_left();
+                if (wait <= 0.0) {
+                    received = false; // (timed out while skipping stale pongs)
+                    break;
+                }
+                TASK_RECV(wait);
+            } while (received && pong_id() != ping_id);
+            if (received) {
+                float sample = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - sent_at).count();
+                *rtt_ms = (*rtt_ms < 0.0f ? sample : *rtt_ms + 0.125f * (sample - *rtt_ms));
+            }
+        }
+        TASK_END();
+    }
+
+    // seconds until the current ping times out:
+    double time_left() const
+    {
+        double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - sent_at).count();
+        return std::max(0.0, PingTimeout - waited);
+    }
+
+    uint32_t pong_id() const
+    {
+        uint32_t id;
+        assert(message_size == sizeof(id));
+        std::memcpy(&id, message, sizeof(id));
+        return id;
+    }
+};
+
 int main(int argc, char** argv)
 {
 #ifdef _WIN32
@@ -35,40 +104,558 @@ int main(int argc, char** argv)
 
         //------------ argument parsing ------------
 
-        if (argc != 2) {
-            std::cerr << "Usage:\n\t./server <port>" << std::endl;
+        std::string port, local_path, checkpoint_path, handoff_path, mirror_path;
+        std::string router_host, router_port, room = DefaultRoom, advertise_host = "localhost";
+        bool lockstep = false;
+        uint32_t bot_count = 0;
+        bool bad_args = false;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--lockstep") {
+                lockstep = true;
+            } else if (arg == "--checkpoint" && i + 1 < argc) {
+                checkpoint_path = argv[++i];
+            } else if (arg == "--handoff" && i + 1 < argc) {
+                handoff_path = argv[++i];
+            } else if (arg == "--bots" && i + 1 < argc) {
+                bot_count = uint32_t(std::stoul(argv[++i]));
+            } else if (arg == "--router" && i + 2 < argc) {
+                router_host = argv[++i];
+                router_port = argv[++i];
+            } else if (arg == "--room" && i + 1 < argc) {
+                room = argv[++i];
+            } else if (arg == "--advertise" && i + 1 < argc) {
+                advertise_host = argv[++i];
+            } else if (arg == "--mirror" && i + 1 < argc) {
+                mirror_path = argv[++i];
+            } else if (arg.compare(0, 2, "--") != 0 && port.empty()) {
+                port = arg;
+            } else if (arg.compare(0, 2, "--") != 0 && local_path.empty()) {
+                local_path = arg;
+            } else {
+                bad_args = true;
+            }
+        }
+        if (lockstep && (!checkpoint_path.empty() || !handoff_path.empty())) {
+            std::cerr << "--lockstep can't be combined with --checkpoint or --handoff." << std::endl;
+            bad_args = true;
+        }
+        if (bad_args || port.empty()) {
+            std::cerr << "Usage:\n\t./server <port> [local-socket-path] [--lockstep] [--bots <count>] [--checkpoint <file>] [--handoff <socket-path>] [--mirror <file>]" << std::endl;
+            std::cerr << "\t                [--router <router host> <router port> [--room <name>] [--advertise <host>]]" << std::endl;
+            std::cerr << "\t(clients on the same host can connect through shared memory with ./client unix:<local-socket-path> 0)" << std::endl;
+            std::cerr << "\t(--lockstep sends every client the inputs for each tick instead of the board; clients run the game themselves)" << std::endl;
+            std::cerr << "\t(--bots adds <count> server-side explorers that race for the treasure)" << std::endl;
+            std::cerr << "\t(--checkpoint keeps the game state in <file>, so it survives a crash or restart)" << std::endl;
+            std::cerr << "\t(--mirror publishes the board and players to <file> every tick for local tools; e.g., ./board-mirror /dev/shm/treasure.mirror)" << std::endl;
+            std::cerr << "\t(--router registers with a ./router, which sends clients of <name> (default " << DefaultRoom << ") to <host> (default localhost) and this port)" << std::endl;
+            std::cerr << "\t(--handoff lets a new server started with the same <socket-path> take over without disconnecting anyone)" << std::endl;
             return 1;
         }
 
         //------------ initialization ------------
 
-        Server server(argv[1]);
+        // takes over from a running server if one is waiting at handoff_path:
+        Server server(port, handoff_path);
+        if (!local_path.empty() && server.local_listen_socket == InvalidSocket) {
+            server.listen_local(local_path);
+        }
+        // clients say hello (send their starting position) right away and send a keepalive every couple of seconds:
+        server.handshake_timeout = 5.0;
+        server.idle_timeout = 10.0;
 
         //------------ main loop ------------
         constexpr float ServerTick = 1.0f / 30.0f; // TODO: set a server tick that makes sense for your game
+        // unchanged state is only re-sent this often, so idle clients still know the server is alive:
+        constexpr float KeepaliveInterval = 1.0f;
+
+        // per-client input limits, so one flooding client can't starve the tick for everyone else:
+        constexpr float InputBatchRate = 120.0f; // sustained input batches per second
+        constexpr float InputBatchBurst = 30.0f;
+        constexpr uint32_t MessagesPerPoll = 8; // most messages handled for one client per poll
+        constexpr float ThrottleReportInterval = 5.0f;
+
+        // a dug treasure stays hidden this long before popping up somewhere else:
+        constexpr float TreasureRespawnDelay = 0.5f;
+
+        // digs are judged against the board the player was looking at, but never one more than this far in the past:
+        constexpr float MaxDigRewind = 0.2f;
+        constexpr uint32_t MaxDigRewindTicks = uint32_t(MaxDigRewind / ServerTick + 0.5f);
+        constexpr uint32_t HistoryTicks = 32; // must be more than MaxDigRewindTicks
+        static_assert(HistoryTicks > MaxDigRewindTicks, "dig history too short for the rewind window");
+
+        // bots take a step this often (so they move at 5 tiles per second):
+        constexpr uint32_t BotMoveTicks = 6;
+        // after the treasure pops up, each bot waits up to this many ticks before heading for it (so races aren't ties):
+        constexpr uint32_t BotMaxReactionTicks = 9;
+
+        // lockstep mode: every this many ticks, a bundle carries the state hash so clients can check they're in sync:
+        constexpr uint32_t LockstepHashInterval = 30;
+
+        // servers in a cluster tell the router how busy they are this often:
+        constexpr float RouterReportInterval = 1.0f;
+
+        // the checkpoint file (if any) is brought up to date this often:
+        constexpr float CheckpointInterval = 1.0f;
 
         // server state:
 
         // per-client state:
         struct PlayerInfo {
-            PlayerInfo()
+            PlayerInfo(uint32_t id_)
+                : id(id_)
+                , name("Player" + std::to_string(id_))
             {
-                static uint32_t next_player_id = 1;
-                name = "Player" + std::to_string(next_player_id);
-                next_player_id += 1;
             }
+            uint32_t id;
             std::string name;
 
             uint32_t pos_x = -1;
             uint32_t pos_y = -1;
             bool enter_pressed = false;
+            uint32_t dug_generation = 0; // newest treasure this player has found (so holding dig only scores once)
+
+            uint32_t last_seq = 0; // newest input applied so far
+            uint32_t last_input_ms = 0; // client timestamp of the newest input batch
+
+            TokenBucket input_bucket = TokenBucket(InputBatchRate, InputBatchBurst);
+            uint32_t throttled_messages = 0; // messages deferred because input_bucket was empty
+            uint32_t reported_throttles = 0; // throttled_messages + connection throttled_polls at the last report
 
             int32_t total = 0;
+
+            float rtt_ms = -1.0f; // round-trip time, kept up to date by the player's PingTask
         };
         std::unordered_map<Connection*, PlayerInfo> players;
+        // read-only subscribers (relays, spectating clients); they get every board message and nothing else:
+        std::unordered_set<Connection*> spectators;
+        uint32_t next_player_id = 1;
+        // per-connection protocol tasks (pings), run from server.poll():
+        TaskScheduler tasks(server.timers);
+
+        // in-process explorers (--bots); they play by feeding inputs to apply_input, just like clients:
+        struct Bot {
+            Bot(uint32_t id)
+                : player(id)
+            {
+                player.name = "Bot" + std::to_string(id);
+            }
+            PlayerInfo player;
+            uint32_t x = 0, y = 0; // position as of the bot's latest input
+            uint32_t next_seq = 1;
+            uint32_t next_move_tick = 0;
+        };
+        std::vector<Bot> bots;
+        // toward the treasure; shared by every bot and rebuilt only when the treasure moves:
+        FlowField flow_field(BOARD_WIDTH, BOARD_HEIGHT);
+
+        // how many players stand on each tile; only occupied tiles take up memory, so this works
+        // the same for a 10x10 board as for a huge, mostly-empty one:
+        SparseGrid<int32_t> occupancy;
+        auto occupy = [&](PlayerInfo const& player, int32_t delta) {
+            if (player.pos_x < BOARD_WIDTH && player.pos_y < BOARD_HEIGHT) {
+                occupancy.add(int32_t(player.pos_x), int32_t(player.pos_y), delta);
+            }
+        };
+
         srand(time(0));
-        int treasure_x = rand() % (BOARD_WIDTH - 1);
-        int treasure_y = rand() % (BOARD_WIDTH - 1);
+        uint32_t treasure_x = rand() % (BOARD_WIDTH - 1);
+        uint32_t treasure_y = rand() % (BOARD_WIDTH - 1);
+        bool treasure_visible = true;
+        uint32_t treasure_generation = 1; // counts up every time the treasure is dug
+
+        // server ticks count up from 0; board messages are stamped with the tick they were sent on,
+        // and clients stamp each input with the tick of the board they were showing:
+        uint32_t tick = 0;
+        // treasure state at the end of each of the last HistoryTicks ticks (indexed by tick % HistoryTicks):
+        struct TreasureState {
+            uint32_t tick = -1; // (-1 = not recorded yet)
+            uint32_t x = 0, y = 0;
+            bool visible = false;
+            uint32_t generation = 0;
+        };
+        std::array<TreasureState, HistoryTicks> history;
+
+        // lockstep mode: the server runs the same simulation as the clients (to check hashes against and to
+        // catch up new clients), but only sends the events that go into it:
+        GameState lockstep_state;
+        lockstep_state.reset(uint64_t(time(0)));
+        std::vector<LockstepEvent> lockstep_events; // to be applied at the start of the next tick
+        std::vector<Connection*> need_snapshot; // get a LockstepStart at the end of this tick instead of a bundle
+        std::vector<uint8_t> bundle;
+
+        // anything that changes the board message bumps state_version; a tick only re-encodes
+        // and broadcasts when it differs from the version that was last sent:
+        uint32_t state_version = 1;
+        uint32_t sent_version = 0;
+        uint32_t encoded_version = 0;
+        std::string status_message; // encoded board for encoded_version
+        auto last_broadcast = std::chrono::steady_clock::now();
+        auto last_throttle_report = std::chrono::steady_clock::now();
+
+        // randomize the treasure location once the respawn delay is up:
+        auto schedule_respawn = [&](uint32_t dig_x, uint32_t dig_y) {
+            server.timers.schedule(TreasureRespawnDelay, [&, dig_x, dig_y]() {
+                do {
+                    treasure_x = rand() % (BOARD_WIDTH - 1);
+                    treasure_y = rand() % (BOARD_WIDTH - 1);
+                    // ensure won't randomly respawn on the same tile
+                } while (treasure_x == dig_x || treasure_y == dig_y);
+                treasure_visible = true;
+                state_version++;
+            });
+        };
+
+        //------------ saving and restoring state ------------
+        // (for the checkpoint file and for handing off to a new server process)
+
+        // game state: (uint32 next player id) (uint32 treasure x) (uint32 treasure y) (uint8 treasure visible)
+        //   (uint32 tick) (uint32 treasure generation) then HistoryTicks x [(uint32 tick) (uint32 x) (uint32 y) (uint8 visible) (uint32 generation)]
+        // per connection: 's' for a spectator, or 'p' (uint32 id) (uint32 x) (uint32 y) (uint32 last seq) (uint32 last input ms) (int32 total)
+        //   (uint32 dug generation)
+        // (the parts on their own lines were added later; state saved without them still restores,
+        //  with the tick, dig history and dug generations starting over)
+        auto put_u32 = [](std::vector<uint8_t>& out, uint32_t v) {
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                out.emplace_back(uint8_t(v >> shift));
+            }
+        };
+        auto get_u32 = [](std::vector<uint8_t> const& in, size_t& at) -> uint32_t {
+            if (at + 4 > in.size())
+                throw std::runtime_error("Saved state is cut short.");
+            uint32_t v = (uint32_t(in[at]) << 24) | (uint32_t(in[at + 1]) << 16) | (uint32_t(in[at + 2]) << 8) | uint32_t(in[at + 3]);
+            at += 4;
+            return v;
+        };
+        auto save_world = [&]() {
+            std::vector<uint8_t> out;
+            put_u32(out, next_player_id);
+            put_u32(out, treasure_x);
+            put_u32(out, treasure_y);
+            out.emplace_back(treasure_visible ? 1 : 0);
+            // (clients echo the tick back in their inputs, so it carries on rather than restarting at 0)
+            put_u32(out, tick);
+            put_u32(out, treasure_generation);
+            for (TreasureState const& state : history) {
+                put_u32(out, state.tick);
+                put_u32(out, state.x);
+                put_u32(out, state.y);
+                out.emplace_back(state.visible ? 1 : 0);
+                put_u32(out, state.generation);
+            }
+            return out;
+        };
+        auto restore_world = [&](std::vector<uint8_t> const& in) {
+            size_t at = 0;
+            next_player_id = get_u32(in, at);
+            treasure_x = get_u32(in, at) % BOARD_WIDTH;
+            treasure_y = get_u32(in, at) % BOARD_HEIGHT;
+            if (at + 1 > in.size())
+                throw std::runtime_error("Saved state is cut short.");
+            treasure_visible = (in[at] != 0);
+            at += 1;
+            if (at < in.size()) {
+                tick = get_u32(in, at);
+                treasure_generation = get_u32(in, at);
+                for (TreasureState& state : history) {
+                    state.tick = get_u32(in, at);
+                    state.x = get_u32(in, at);
+                    state.y = get_u32(in, at);
+                    if (at + 1 > in.size())
+                        throw std::runtime_error("Saved state is cut short.");
+                    state.visible = (in[at] != 0);
+                    at += 1;
+                    state.generation = get_u32(in, at);
+                }
+            }
+            // (the respawn timer didn't survive the restart)
+            if (!treasure_visible)
+                schedule_respawn(treasure_x, treasure_y);
+            state_version++;
+        };
+        auto save_connection = [&](Connection* c) {
+            std::vector<uint8_t> out;
+            auto f = players.find(c);
+            if (f == players.end()) {
+                out.emplace_back('s');
+                return out;
+            }
+            PlayerInfo const& player = f->second;
+            out.emplace_back('p');
+            put_u32(out, player.id);
+            put_u32(out, player.pos_x);
+            put_u32(out, player.pos_y);
+            put_u32(out, player.last_seq);
+            put_u32(out, player.last_input_ms);
+            put_u32(out, uint32_t(player.total));
+            put_u32(out, player.dug_generation);
+            return out;
+        };
+        auto restore_connection = [&](Connection* c, std::vector<uint8_t> const& in) {
+            if (in.empty())
+                throw std::runtime_error("Saved connection state is empty.");
+            if (in[0] == 's') {
+                spectators.insert(c);
+                return;
+            }
+            if (in[0] != 'p')
+                throw std::runtime_error("Saved connection state has an unknown tag.");
+            size_t at = 1;
+            PlayerInfo player(get_u32(in, at));
+            player.pos_x = get_u32(in, at);
+            player.pos_y = get_u32(in, at);
+            player.last_seq = get_u32(in, at);
+            player.last_input_ms = get_u32(in, at);
+            player.total = int32_t(get_u32(in, at));
+            if (at < in.size())
+                player.dug_generation = get_u32(in, at);
+            occupy(player, +1);
+            auto inserted = players.emplace(c, player);
+            tasks.start<PingTask>(c, &inserted.first->second.rtt_ms);
+        };
+
+        std::unique_ptr<Checkpoint> checkpoint;
+        if (!checkpoint_path.empty()) {
+            checkpoint = std::make_unique<Checkpoint>(checkpoint_path);
+        }
+
+        if (!server.handoff_connection_state.empty() || !server.handoff_state.empty()) {
+            // took over from a previous server; carry on exactly where it left off:
+            restore_world(server.handoff_state);
+            for (auto const& [c, state] : server.handoff_connection_state) {
+                restore_connection(c, state);
+            }
+            std::cout << "Took over " << players.size() << " players and " << spectators.size() << " spectators." << std::endl;
+        } else if (std::vector<uint8_t> saved; checkpoint && checkpoint->load(&saved)) {
+            // restarting after a crash: players have to reconnect, but the board picks up where it was:
+            restore_world(saved);
+            std::cout << "Restored game state from '" << checkpoint_path << "'." << std::endl;
+        }
+        server.handoff_state.clear();
+        server.handoff_connection_state.clear();
+
+        if (!handoff_path.empty()) {
+            server.listen_handoff(handoff_path);
+        }
+
+        // save whenever the game state has changed, at most once per CheckpointInterval:
+        uint32_t checkpoint_version = 0;
+        std::function<void()> save_checkpoint = [&]() {
+            if (checkpoint_version != state_version) {
+                checkpoint->save(save_world());
+                checkpoint_version = state_version;
+            }
+            server.timers.schedule(CheckpointInterval, save_checkpoint);
+        };
+        if (checkpoint) {
+            save_checkpoint();
+        }
+
+        // local tools can watch the board through a shared mapping instead of connecting:
+        std::unique_ptr<BoardMirror> mirror;
+        if (!mirror_path.empty()) {
+            mirror = std::make_unique<BoardMirror>(mirror_path);
+        }
+        std::vector<BoardMirror::Player> mirror_players; // (reused every tick)
+        auto publish_mirror = [&](uint32_t mirror_tick, std::string const& board) {
+            mirror_players.clear();
+            auto add = [&](PlayerInfo const& player) {
+                uint32_t x = player.pos_x, y = player.pos_y;
+                int32_t total = player.total;
+                if (lockstep) {
+                    // (PlayerInfo positions and totals aren't kept up to date in lockstep mode; the simulation is)
+                    auto f = lockstep_state.players.find(player.id);
+                    if (f == lockstep_state.players.end())
+                        return;
+                    x = f->second.pos_x;
+                    y = f->second.pos_y;
+                    total = f->second.total;
+                }
+                BoardMirror::Player entry;
+                entry.id = player.id;
+                entry.pos_x = (x < BOARD_WIDTH ? uint8_t(x) : 0xff);
+                entry.pos_y = (y < BOARD_HEIGHT ? uint8_t(y) : 0xff);
+                if (player.rtt_ms >= 0.0f)
+                    entry.rtt_ms = uint16_t(std::min(player.rtt_ms + 0.5f, 65534.0f));
+                entry.total = total;
+                std::strncpy(entry.name, player.name.c_str(), sizeof(entry.name) - 1);
+                mirror_players.emplace_back(entry);
+            };
+            for (auto const& [c, player] : players) {
+                (void)c;
+                add(player);
+            }
+            for (auto const& bot : bots) {
+                add(bot.player);
+            }
+            std::sort(mirror_players.begin(), mirror_players.end(), [](BoardMirror::Player const& a, BoardMirror::Player const& b) { return a.id < b.id; });
+            mirror->publish(mirror_tick, board, mirror_players);
+        };
+
+        // in a cluster, the router sends this server clients for its room, depending on the load reported here:
+        std::unique_ptr<Client> router;
+        if (!router_host.empty()) {
+            router = std::make_unique<Client>(router_host, router_port);
+            send_register(&router->connection, room, advertise_host, port);
+        }
+        std::function<void()> report_load = [&]() {
+            if (!router)
+                return;
+            send_load(&router->connection, uint32_t(players.size() + spectators.size()));
+            server.timers.schedule(RouterReportInterval, report_load);
+        };
+        report_load();
+
+        // forget a player (who left, misbehaved, or turned out to be a spectator):
+        auto remove_player = [&](std::unordered_map<Connection*, PlayerInfo>::iterator f) {
+            tasks.stop(f->first);
+            occupy(f->second, -1);
+            if (lockstep) {
+                LockstepEvent event;
+                event.player = f->second.id;
+                event.type = LockstepEvent::Leave;
+                lockstep_events.emplace_back(event);
+            }
+            state_version++;
+            return players.erase(f);
+        };
+
+        // apply one input from a player (a client's, or a bot's); inputs at or before last_seq were already applied:
+        auto apply_input = [&](PlayerInfo& player, InputRecord const& input) {
+            if (input.seq <= player.last_seq)
+                return;
+            player.last_seq = input.seq;
+
+            if (lockstep) {
+                // every peer applies it at the start of the next tick:
+                LockstepEvent event;
+                event.player = player.id;
+                event.type = LockstepEvent::Input;
+                event.pos_x = input.pos_x;
+                event.pos_y = input.pos_y;
+                event.enter = input.enter;
+                lockstep_events.emplace_back(event);
+                return;
+            }
+
+            if (player.pos_x != input.pos_x || player.pos_y != input.pos_y) {
+                state_version++;
+                occupy(player, -1);
+                player.pos_x = input.pos_x;
+                player.pos_y = input.pos_y;
+                occupy(player, +1);
+            }
+            player.enter_pressed = input.enter;
+            if (!player.enter_pressed)
+                return;
+
+            // judge the dig against what the player saw, rewinding no further than MaxDigRewindTicks:
+            // (a tick from the future, e.g., from before a restart, is judged against the present)
+            uint32_t rewind = (input.seen_tick <= tick ? std::min(tick - input.seen_tick, MaxDigRewindTicks) : 0);
+            TreasureState seen = history[(tick - rewind) % HistoryTicks];
+            if (rewind == 0 || seen.tick != tick - rewind) {
+                seen.x = treasure_x;
+                seen.y = treasure_y;
+                seen.visible = treasure_visible;
+                seen.generation = treasure_generation;
+            }
+            if (!seen.visible || player.pos_x != seen.x || player.pos_y != seen.y || player.dug_generation == seen.generation)
+                return;
+
+            player.dug_generation = seen.generation;
+            player.total += 1;
+            if (seen.generation == treasure_generation && treasure_visible) {
+                // the treasure is still there; dig it up:
+                state_version++;
+                treasure_visible = false;
+                treasure_generation++;
+                schedule_respawn(player.pos_x, player.pos_y);
+            }
+            // (otherwise someone else got to it first in server time, but this player found it
+            //  on their screen before that dig reached them, so they get the find too)
+            std::cout << " " << player.name << " found the treasure" << (rewind ? " (" + std::to_string(rewind) + " ticks ago)" : "") << "; total " << player.total << std::endl;
+        };
+
+        // handle (up to MessagesPerPoll, rate limited) messages waiting in a client's recv_buffer;
+        // anything left over stays in the buffer for a later poll or tick.
+        // returns false if the client sent something bad and should be disconnected:
+        auto handle_messages = [&](Connection* c, PlayerInfo& player) -> bool {
+            for (uint32_t handled = 0; handled < MessagesPerPoll && !c->recv_buffer.empty(); handled++) {
+                Message type = Message(c->recv_buffer[0]);
+                if (type == Message::C2S_Pong) {
+                    uint32_t id;
+                    if (!recv_ping(c, Message::C2S_Pong, &id))
+                        break; // wait for the rest of it
+                    tasks.deliver(c, reinterpret_cast<uint8_t const*>(&id), sizeof(id));
+                    continue;
+                }
+                if (type == Message::C2S_Join) {
+                    // (meant for ./router; see the check in OnRecv)
+                    if (!recv_join(c, nullptr))
+                        break; // wait for the rest of it
+                    continue;
+                }
+                if (type == Message::C2S_Resync && lockstep) {
+                    std::cout << " " << player.name << " is out of sync; sending a new snapshot." << std::endl;
+                    c->recv_buffer.erase(c->recv_buffer.begin());
+                    if (std::find(need_snapshot.begin(), need_snapshot.end(), c) == need_snapshot.end())
+                        need_snapshot.emplace_back(c);
+                    continue;
+                }
+                if (type != Message::C2S_Inputs) {
+                    std::cout << " message of unknown type '" << char(type) << "' received from client!" << std::endl;
+                    return false;
+                }
+
+                if (!player.input_bucket.ready()) {
+                    player.throttled_messages++;
+                    break;
+                }
+
+                std::vector<InputRecord> inputs;
+                try {
+                    if (!recv_input_batch(c, &player.last_input_ms, &inputs))
+                        break; // wait for the rest of the batch
+                } catch (std::exception const& e) {
+                    std::cout << " bad input batch from client: " << e.what() << std::endl;
+                    return false;
+                }
+                player.input_bucket.take();
+
+                // batches repeat the last few inputs; only apply the ones not seen yet:
+                for (auto const& input : inputs) {
+                    apply_input(player, input);
+                }
+            }
+            return true;
+        };
+
+        // bots send inputs stamped with the current tick, so their digs are never rewound:
+        auto bot_input = [&](Bot& bot, bool dig) {
+            InputRecord input;
+            input.seq = bot.next_seq++;
+            input.pos_x = uint8_t(bot.x);
+            input.pos_y = uint8_t(bot.y);
+            input.enter = dig;
+            input.seen_tick = tick;
+            apply_input(bot.player, input);
+        };
+        // bots join the way clients do: their first input puts them somewhere on the board
+        // (bots is never resized after this, so their PlayerInfo stays put)
+        bots.reserve(bot_count);
+        for (uint32_t i = 0; i < bot_count; i++) {
+            bots.emplace_back(next_player_id++);
+            Bot& bot = bots.back();
+            if (lockstep) {
+                LockstepEvent event;
+                event.player = bot.player.id;
+                event.type = LockstepEvent::Join;
+                lockstep_events.emplace_back(event);
+            }
+            bot.x = rand() % (BOARD_WIDTH - 1);
+            bot.y = rand() % (BOARD_HEIGHT - 1);
+            bot_input(bot, false);
+        }
 
         while (true) {
             static auto next_tick = std::chrono::steady_clock::now() + std::chrono::duration<double>(ServerTick);
@@ -78,6 +665,7 @@ int main(int argc, char** argv)
                 double remain = std::chrono::duration<double>(next_tick - now).count();
                 if (remain < 0.0) {
                     next_tick += std::chrono::duration<double>(ServerTick);
+                    tick++;
                     break;
                 }
                 server.poll([&](Connection* c, Connection::Event evt) {
@@ -85,15 +673,31 @@ int main(int argc, char** argv)
                         // client connected:
 
                         // create some player info for them:
-                        players.emplace(c, PlayerInfo());
+                        auto inserted = players.emplace(c, PlayerInfo(next_player_id++));
+                        // make sure the new client gets a snapshot on the next tick:
+                        state_version++;
+                        tasks.start<PingTask>(c, &inserted.first->second.rtt_ms);
+                        if (lockstep) {
+                            LockstepEvent event;
+                            event.player = inserted.first->second.id;
+                            event.type = LockstepEvent::Join;
+                            lockstep_events.emplace_back(event);
+                            need_snapshot.emplace_back(c);
+                        }
 
                     } else if (evt == Connection::OnClose) {
                         // client disconnected:
 
-                        // remove them from the players list:
+                        // remove them from the players (or spectators) list:
                         auto f = players.find(c);
-                        assert(f != players.end());
-                        players.erase(f);
+                        need_snapshot.erase(std::remove(need_snapshot.begin(), need_snapshot.end(), c), need_snapshot.end());
+                        if (f != players.end()) {
+                            remove_player(f);
+                        } else {
+                            size_t erased = spectators.erase(c);
+                            assert(erased == 1);
+                            (void)erased;
+                        }
 
                     } else {
                         assert(evt == Connection::OnRecv);
@@ -102,73 +706,215 @@ int main(int argc, char** argv)
                                   << hex_dump(c->recv_buffer);
                         std::cout.flush();
 
+                        // spectators only ever repeat their hello (or, in lockstep mode, ask for a resync):
+                        if (spectators.count(c)) {
+                            auto end = std::find_if(c->recv_buffer.begin(), c->recv_buffer.end(), [](uint8_t b) { return b != uint8_t(Message::C2S_Spectate) && b != uint8_t(Message::C2S_Resync); });
+                            bool bad = (end != c->recv_buffer.end());
+                            bool resync = std::count(c->recv_buffer.begin(), end, uint8_t(Message::C2S_Resync)) > 0;
+                            if (resync && lockstep && std::find(need_snapshot.begin(), need_snapshot.end(), c) == need_snapshot.end())
+                                need_snapshot.emplace_back(c);
+                            c->recv_buffer.erase(c->recv_buffer.begin(), end);
+                            if (bad) {
+                                std::cout << " spectator sent something other than a hello; disconnecting." << std::endl;
+                                c->close();
+                                spectators.erase(c);
+                            }
+                            return;
+                        }
+
                         // look up in players list:
                         auto f = players.find(c);
                         assert(f != players.end());
-                        PlayerInfo& player = f->second;
 
-                        // handle messages from client:
-                        // TODO: update for the sorts of messages your clients send
-                        const size_t msg_len = 4;
-                        while (c->recv_buffer.size() >= msg_len) {
-                            // expecting five-byte messages 'b' (left count) (right count) (down count) (up count)
-                            char type = c->recv_buffer[0];
-                            if (type != 'b') {
-                                std::cout << " message of non-'b' type received from client!" << std::endl;
-                                // shut down client connection:
-                                c->close();
+                        // a room name may come first; it's meant for ./router, as this server hosts just the one room:
+                        if (c->recv_buffer[0] == uint8_t(Message::C2S_Join) && f->second.last_seq == 0) {
+                            std::string asked;
+                            if (!recv_join(c, &asked))
+                                return; // wait for the rest of it
+                            if (asked != room)
+                                std::cout << " " << f->second.name << " asked for room '" << asked << "', but this server hosts '" << room << "'." << std::endl;
+                            if (c->recv_buffer.empty())
                                 return;
-                            }
-                            uint8_t pos_x = c->recv_buffer[1];
-                            uint8_t pos_y = c->recv_buffer[2];
-                            uint8_t enter_count = c->recv_buffer[3];
-
-                            player.pos_x = pos_x;
-                            player.pos_y = pos_y;
-                            player.enter_pressed = enter_count;
-                            if (player.pos_x == treasure_x && player.pos_y == treasure_y && player.enter_pressed > 0) {
-                                // randomize the treasure location
-                                do {
-                                    treasure_x = rand() % (BOARD_WIDTH - 1);
-                                    treasure_y = rand() % (BOARD_WIDTH - 1);
-                                    // ensure won't randomly respawn on the same tile
-                                } while (treasure_x == player.pos_x || treasure_y == player.pos_y);
-                            }
+                        }
+
+                        // a new connection that says 's' first is a spectator (or relay), not a player:
+                        if (c->recv_buffer[0] == uint8_t(Message::C2S_Spectate) && f->second.last_seq == 0) {
+                            std::cout << " " << f->second.name << " is spectating." << std::endl;
+                            remove_player(f);
+                            spectators.insert(c);
+                            c->recv_buffer.erase(c->recv_buffer.begin());
+                            // (send the current board right away, rather than waiting for a change or keepalive)
+                            if (encoded_version != 0 && !lockstep)
+                                send_board(c, tick, status_message);
+                            return;
+                        }
+                        PlayerInfo& player = f->second;
 
-                            c->recv_buffer.erase(c->recv_buffer.begin(), c->recv_buffer.begin() + msg_len);
+                        // handle messages from client:
+                        if (!handle_messages(c, player)) {
+                            // shut down client connection:
+                            c->close();
+                            remove_player(f);
                         }
                     }
                 },
                     remain);
             }
 
+            // messages held back by the per-poll or rate limits get another chance every tick:
+            for (auto it = players.begin(); it != players.end(); /* later */) {
+                Connection* c = it->first;
+                if (c->recv_buffer.empty() || handle_messages(c, it->second)) {
+                    ++it;
+                } else {
+                    c->close();
+                    it = remove_player(it);
+                }
+            }
+
+            // a new server process wants to take over; pass everything to it and bow out:
+            if (server.handoff_requested()) {
+                if (checkpoint)
+                    checkpoint->save(save_world());
+                if (server.hand_off(save_world(), save_connection)) {
+                    std::cout << "Handed off to the new server; exiting." << std::endl;
+                    return 0;
+                }
+            }
+
+            // push out load reports (the router never sends anything back):
+            if (router) {
+                bool lost = false;
+                router->poll([&](Connection*, Connection::Event evt) {
+                    lost = lost || (evt == Connection::OnClose);
+                },
+                    0.0);
+                if (lost) {
+                    std::cout << "Lost the connection to the router; no longer reporting load." << std::endl;
+                    router.reset();
+                }
+            }
+
+            auto now = std::chrono::steady_clock::now();
+
+            // report clients that have been hitting the limits:
+            if (now - last_throttle_report >= std::chrono::duration<double>(ThrottleReportInterval)) {
+                last_throttle_report = now;
+                for (auto& [c, player] : players) {
+                    uint32_t throttles = player.throttled_messages + c->throttled_polls;
+                    if (throttles == player.reported_throttles)
+                        continue;
+                    std::cout << "[throttle] " << player.name << ": " << player.throttled_messages << " messages deferred by rate limit, "
+                              << c->throttled_polls << " reads cut short, " << c->recv_buffer.size() << " bytes pending." << std::endl;
+                    player.reported_throttles = throttles;
+                }
+            }
+
+            // bots head for the treasure, one tile per BotMoveTicks, and dig when they get there:
+            if (!bots.empty()) {
+                uint32_t goal_x = (lockstep ? lockstep_state.treasure_x : treasure_x);
+                uint32_t goal_y = (lockstep ? lockstep_state.treasure_y : treasure_y);
+                bool goal_visible = (lockstep ? lockstep_state.treasure_visible : treasure_visible);
+                if (goal_visible && (!flow_field.built || flow_field.target_x != goal_x || flow_field.target_y != goal_y)) {
+                    // the treasure popped up somewhere new: one search serves every bot
+                    flow_field.build(goal_x, goal_y);
+                    for (auto& bot : bots) {
+                        bot.next_move_tick = tick + 1 + rand() % BotMaxReactionTicks;
+                    }
+                }
+                for (auto& bot : bots) {
+                    if (!goal_visible || tick < bot.next_move_tick)
+                        continue;
+                    bot.next_move_tick = tick + BotMoveTicks;
+                    uint32_t next_x, next_y;
+                    if (flow_field.step(bot.x, bot.y, &next_x, &next_y)) {
+                        bot.x = next_x;
+                        bot.y = next_y;
+                        bot_input(bot, false);
+                    } else {
+                        bot_input(bot, true);
+                    }
+                }
+            }
+
+            if (lockstep) {
+                // run this tick's events, then send them to everyone who is caught up:
+                for (auto const& event : lockstep_events) {
+                    lockstep_state.apply(event);
+                }
+                lockstep_state.step();
+                uint64_t hash = 0;
+                bool send_hash = (lockstep_state.tick % LockstepHashInterval == 0);
+                if (send_hash)
+                    hash = lockstep_state.hash();
+                bundle.clear();
+                append_tick_bundle(&bundle, lockstep_state.tick, lockstep_events, send_hash ? &hash : nullptr);
+                lockstep_events.clear();
+
+                auto send_bundle = [&](Connection* c) {
+                    if (std::find(need_snapshot.begin(), need_snapshot.end(), c) == need_snapshot.end())
+                        c->send_raw(bundle.data(), bundle.size());
+                };
+                for (auto& [c, player] : players) {
+                    (void)player;
+                    send_bundle(c);
+                }
+                for (Connection* c : spectators) {
+                    send_bundle(c);
+                }
+                // newcomers (and anyone out of sync) start from the state as of this tick:
+                for (Connection* c : need_snapshot) {
+                    auto f = players.find(c);
+                    send_lockstep_start(c, f != players.end() ? f->second.id : 0, lockstep_state);
+                }
+                need_snapshot.clear();
+                if (mirror)
+                    publish_mirror(lockstep_state.tick, lockstep_state.encode_board());
+                continue;
+            }
+
+            // remember what the treasure looked like as of this tick, for judging late digs:
+            history[tick % HistoryTicks] = TreasureState { tick, treasure_x, treasure_y, treasure_visible, treasure_generation };
+
             // update current game state
             // TODO: replace with *your* game state update
-            constexpr size_t msg_len = BOARD_WIDTH * BOARD_HEIGHT;
-            char board[msg_len] = { 0 };
+            if (state_version != encoded_version) {
+                constexpr size_t msg_len = BOARD_WIDTH * BOARD_HEIGHT;
+                char board[msg_len] = { 0 };
 
-            for (auto& [c, player] : players) {
-                int idx = player.pos_x + player.pos_y * BOARD_WIDTH;
-                // std::cout << "position: " << player.pos_x << " " << player.pos_y << std::endl;
-                if (idx >= 0 && idx < msg_len)
-                    board[idx]++;
+                // (only visits occupied tiles)
+                occupancy.for_each([&](int32_t x, int32_t y, int32_t count) {
+                    board[x + y * BOARD_WIDTH] = char(std::min(count, 127));
+                });
+
+                if (treasure_visible) {
+                    size_t treasure_idx = treasure_x + BOARD_WIDTH * treasure_y;
+                    board[treasure_idx] = -board[treasure_idx];
+                }
+                status_message.assign(board, msg_len);
+                encoded_version = state_version;
+                // std::cout << status_message << std::endl; // DEBUG
             }
+            if (mirror)
+                publish_mirror(tick, status_message);
 
-            size_t treasure_idx = treasure_x + BOARD_WIDTH * treasure_y;
-            board[treasure_idx] = -board[treasure_idx];
-            std::string status_message(board, msg_len);
-            // std::cout << status_message << std::endl; // DEBUG
+            // nothing changed since the last broadcast: only send a keepalive once in a while
+            bool keepalive_due = (now - last_broadcast) >= std::chrono::duration<double>(KeepaliveInterval);
+            if (state_version == sent_version && !keepalive_due) {
+                continue;
+            }
+            sent_version = state_version;
+            last_broadcast = now;
 
             // send updated game state to all clients
             // TODO: update for your game state
             for (auto& [c, player] : players) {
                 (void)player; // work around "unused variable" warning on whatever g++ github actions uses
-                // send an update starting with 'm', a 24-bit size, and a blob of text:
-                c->send('m');
-                c->send(uint8_t(status_message.size() >> 16));
-                c->send(uint8_t((status_message.size() >> 8) % 256));
-                c->send(uint8_t(status_message.size() % 256));
-                c->send_buffer.insert(c->send_buffer.end(), status_message.begin(), status_message.end());
+                send_board(c, tick, status_message);
+            }
+            // (however many people are watching through relays, each relay costs one send here)
+            for (Connection* c : spectators) {
+                send_board(c, tick, status_message);
             }
         }
 